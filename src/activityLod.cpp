@@ -0,0 +1,100 @@
+//
+//  activityLod.cpp
+//  PS3_Homography
+//
+
+#include "activityLod.h"
+
+ActivityLod::ActivityLod() {
+    enabled = false;
+    influenceRadius = 150;
+    sleepSpeed = 15;
+    sleepFrames = 30;
+    freezeFrames = 300;
+    wakePending = waking = false;
+    counts[0] = counts[1] = counts[2] = 0;
+}
+
+void ActivityLod::begin() {
+    zones.clear();
+    waking = wakePending;
+    wakePending = false;
+    counts[0] = counts[1] = counts[2] = 0;
+}
+
+void ActivityLod::addZone(const ofPoint &center, float radius) {
+    Zone zone;
+    zone.center = center;
+    zone.radius = radius + influenceRadius;
+    zones.push_back(zone);
+}
+
+bool ActivityLod::isNear(const ofPoint &p, float radius) const {
+    for(int i=0; i<zones.size(); i++) {
+        float reach = zones[i].radius + radius;
+        if(p.squareDistance(zones[i].center) < reach * reach) return true;
+    }
+    return false;
+}
+
+bool ActivityLod::update(b2Body* body) {
+    Body &state = bodies[body];
+    state.seen = true;
+    
+    ofPoint pos(body->GetPosition().x * OFX_BOX2D_SCALE, body->GetPosition().y * OFX_BOX2D_SCALE);
+    bool near = !enabled || isNear(pos, 0);
+    if(near || waking) {
+        if(body->GetType() == b2_staticBody || !body->IsAwake()) wake(body);
+        state.idle = 0;
+        counts[ACTIVITY_ACTIVE]++;
+        return near;
+    }
+    
+    //far away: count idle frames while it is slow, then sleep and later freeze
+    if(body->GetType() == b2_staticBody) {
+        counts[ACTIVITY_FROZEN]++;
+        return false;
+    }
+    float speed = body->GetLinearVelocity().Length() * OFX_BOX2D_SCALE;
+    if(body->IsAwake() && speed > sleepSpeed) {
+        state.idle = 0;
+        counts[ACTIVITY_ACTIVE]++;
+        return false;
+    }
+    state.idle++;
+    if(state.idle >= sleepFrames + freezeFrames) {
+        body->SetType(b2_staticBody);
+        counts[ACTIVITY_FROZEN]++;
+    } else if(state.idle >= sleepFrames) {
+        //a contact with an awake body still wakes it in box2d
+        body->SetAwake(false);
+        counts[ACTIVITY_SLEEPING]++;
+    } else {
+        counts[ACTIVITY_ACTIVE]++;
+    }
+    return false;
+}
+
+void ActivityLod::reset() {
+    zones.clear();
+    bodies.clear();
+    wakePending = waking = false;
+    counts[0] = counts[1] = counts[2] = 0;
+}
+
+void ActivityLod::end() {
+    for(map<b2Body*, Body>::iterator it = bodies.begin(); it != bodies.end(); ) {
+        if(!it->second.seen) {
+            bodies.erase(it++);
+        } else {
+            it->second.seen = false;
+            ++it;
+        }
+    }
+}
+
+void ActivityLod::wake(b2Body* body) {
+    if(body->GetType() == b2_staticBody) body->SetType(b2_dynamicBody);
+    body->SetAwake(true);
+    bodies[body].idle = 0;
+}
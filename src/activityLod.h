@@ -0,0 +1,72 @@
+//
+//  activityLod.h
+//  PS3_Homography
+//
+//  Level of detail for the free bodies (circles and particles). Each frame
+//  every tracked contour adds an influence zone. Bodies inside a zone are
+//  active and get the contour forces. Bodies outside every zone are put to
+//  sleep once they have been slow for a while. Bodies that stay asleep
+//  long enough become static, which takes them out of the solver. A body
+//  wakes up as soon as a zone reaches it again.
+//
+
+#ifndef PS3_Homography_activityLod_h
+#define PS3_Homography_activityLod_h
+
+#include "ofMain.h"
+#include "ofxBox2d.h"
+
+enum ActivityState {
+    ACTIVITY_ACTIVE = 0,
+    ACTIVITY_SLEEPING,
+    ACTIVITY_FROZEN
+};
+
+class ActivityLod {
+    
+public:
+    ActivityLod();
+    
+    //zones are in window coordinates, the same space as the bodies
+    void begin();
+    void addZone(const ofPoint &center, float radius);
+    //true if the body is near a contour and should get its forces this frame
+    bool update(b2Body* body);
+    //forgets bodies that were not updated this frame
+    void end();
+    //forgets every body and zone, for a world that starts over
+    void reset();
+    
+    //wakes every body on the next update, for changes that affect far
+    //bodies too (gravity, walls)
+    void wakeAll() { wakePending = true; }
+    
+    bool isNear(const ofPoint &p, float radius) const;
+    int getCount(ActivityState state) const { return counts[state]; }
+    
+    bool  enabled;          //off by default, sleeping far bodies change how the scene plays
+    float influenceRadius;  //added around each contour's extent
+    float sleepSpeed;       //pixels per second below which a far body counts as idle
+    int   sleepFrames;      //idle frames before a far body sleeps
+    int   freezeFrames;     //frames asleep before it becomes static
+    
+private:
+    struct Zone {
+        ofPoint center;
+        float   radius;
+    };
+    struct Body {
+        Body() : idle(0), seen(false) {}
+        int  idle;
+        bool seen;
+    };
+    
+    void wake(b2Body* body);
+    
+    bool               wakePending, waking;
+    vector<Zone>       zones;
+    map<b2Body*, Body> bodies;
+    int                counts[3];
+};
+
+#endif
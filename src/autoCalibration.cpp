@@ -0,0 +1,413 @@
+//
+//  autoCalibration.cpp
+//  PS3_Homography
+//
+
+#include "autoCalibration.h"
+
+using namespace cv;
+using namespace ofxCv;
+
+static int bitsFor(int count) {
+    int bits = 1;
+    while((1 << bits) < count) bits++;
+    return bits;
+}
+
+//--------------------------------------------------------------
+GrayCodePattern::GrayCodePattern() {
+    minContrast = 40;
+    minBitContrast = 12;
+    minCellPixels = 4;
+    width = height = 0;
+    cellSize = 16;
+    columns = rows = 1;
+    columnBits = rowBits = 1;
+}
+
+void GrayCodePattern::setup(int width, int height, int cellSize) {
+    this->width = width;
+    this->height = height;
+    this->cellSize = MAX(cellSize, 1);
+    columns = (width + this->cellSize - 1) / this->cellSize;
+    rows = (height + this->cellSize - 1) / this->cellSize;
+    columnBits = bitsFor(columns);
+    rowBits = bitsFor(rows);
+    frames.assign(size(), ofPixels());
+}
+
+void GrayCodePattern::render(int index, ofPixels &out) const {
+    out.allocate(width, height, OF_PIXELS_GRAY);
+    unsigned char *data = out.getData();
+    if(index < 2) {
+        memset(data, index == 0 ? 255 : 0, width * height);
+        return;
+    }
+    int bit = (index - 2) / 2;
+    bool inverse = (index - 2) % 2 == 1;
+    bool vertical = bit < columnBits;
+    int shift = vertical ? columnBits - 1 - bit : rowBits - 1 - (bit - columnBits);
+    for(int y=0; y<height; y++) {
+        unsigned char *row = data + y * width;
+        if(vertical && y > 0) {
+            //column stripes are the same on every row
+            memcpy(row, data, width);
+            continue;
+        }
+        for(int x=0; x<width; x++) {
+            int cell = vertical ? x / cellSize : y / cellSize;
+            int gray = cell ^ (cell >> 1);
+            row[x] = (((gray >> shift) & 1) == 1) != inverse ? 255 : 0;
+        }
+    }
+}
+
+void GrayCodePattern::add(int index, const ofPixels &camera) {
+    ofPixels &gray = frames[index];
+    int channels = camera.getNumChannels();
+    if(channels == 1) {
+        gray = camera;
+        return;
+    }
+    int n = camera.getWidth() * camera.getHeight();
+    gray.allocate(camera.getWidth(), camera.getHeight(), OF_PIXELS_GRAY);
+    const unsigned char *in = camera.getData();
+    unsigned char *out = gray.getData();
+    for(int i=0; i<n; i++, in += channels) {
+        out[i] = (77 * in[0] + 150 * in[1] + 29 * in[2]) >> 8;
+    }
+}
+
+//the cell index coded in bits frames from first on, -1 if any bit is unclear
+int GrayCodePattern::readBits(const vector<const unsigned char*> &data, int pixel, int first, int bits) const {
+    int gray = 0;
+    for(int b=0; b<bits; b++) {
+        int on = data[first + 2*b][pixel], off = data[first + 2*b + 1][pixel];
+        if(abs(on - off) < minBitContrast) return -1;
+        gray = (gray << 1) | (on > off ? 1 : 0);
+    }
+    int cell = gray;
+    for(int shift = gray >> 1; shift; shift >>= 1) cell ^= shift;
+    return cell;
+}
+
+int GrayCodePattern::decode(vector<ofVec2f> &cameraPoints, vector<ofVec2f> &projectorPoints) const {
+    cameraPoints.clear();
+    projectorPoints.clear();
+    vector<const unsigned char*> data(frames.size());
+    for(int i=0; i<frames.size(); i++) {
+        if(!frames[i].isAllocated()) return 0;
+        data[i] = frames[i].getData();
+    }
+
+    int w = frames[0].getWidth(), h = frames[0].getHeight();
+    vector<double> sumX(columns * rows, 0), sumY(columns * rows, 0);
+    vector<int> count(columns * rows, 0);
+    for(int y=0; y<h; y++) {
+        for(int x=0; x<w; x++) {
+            int i = y * w + x;
+            if(data[0][i] - data[1][i] < minContrast) continue;
+            int column = readBits(data, i, 2, columnBits);
+            if(column < 0 || column >= columns) continue;
+            int row = readBits(data, i, 2 + 2 * columnBits, rowBits);
+            if(row < 0 || row >= rows) continue;
+            int cell = row * columns + column;
+            sumX[cell] += x;
+            sumY[cell] += y;
+            count[cell]++;
+        }
+    }
+
+    //the centroid of all camera pixels seeing a cell is far finer than one pixel
+    for(int cell=0; cell<count.size(); cell++) {
+        if(count[cell] < minCellPixels) continue;
+        int column = cell % columns, row = cell / columns;
+        int x0 = column * cellSize, x1 = MIN(x0 + cellSize, width);
+        int y0 = row * cellSize, y1 = MIN(y0 + cellSize, height);
+        cameraPoints.push_back(ofVec2f(sumX[cell] / count[cell], sumY[cell] / count[cell]));
+        projectorPoints.push_back(ofVec2f((x0 + x1 - 1) * 0.5f, (y0 + y1 - 1) * 0.5f));
+    }
+    return cameraPoints.size();
+}
+
+//--------------------------------------------------------------
+AutoCalibration::AutoCalibration() {
+    settleFrames = 6;
+    cellSize = 16;
+    ransacThreshold = 2;
+    syntheticTolerance = 1;
+    running = false;
+    camWidth = 320;
+    camHeight = 240;
+    current = step = waiting = 0;
+    patternVersion = 0;
+}
+
+void AutoCalibration::start(const ProjectorLayout &layout, int camWidth, int camHeight) {
+    this->camWidth = camWidth;
+    this->camHeight = camHeight;
+    regions.clear();
+    viewports.clear();
+    codes.clear();
+    for(int r=0; r<layout.regions.size(); r++) {
+        const ofRectangle &viewport = layout.regions[r].viewport;
+        regions.push_back(r);
+        viewports.push_back(viewport);
+        codes.push_back(GrayCodePattern());
+        codes.back().setup(viewport.width, viewport.height, cellSize);
+    }
+    current = step = 0;
+    running = !regions.empty();
+    if(running) showPattern();
+}
+
+void AutoCalibration::stop() {
+    running = false;
+}
+
+void AutoCalibration::showPattern() {
+    codes[current].render(step, pattern);
+    patternVersion++;
+    waiting = settleFrames;
+}
+
+bool AutoCalibration::addCameraFrame(const ofPixels &camera) {
+    if(!running) return false;
+    //the projector and the camera exposure both lag the pattern change
+    if(waiting > 0) {
+        waiting--;
+        return false;
+    }
+    codes[current].add(step, camera);
+    if(++step == codes[current].size()) {
+        step = 0;
+        if(++current == regions.size()) {
+            running = false;
+            current = 0;
+            return true;
+        }
+    }
+    showPattern();
+    return false;
+}
+
+float AutoCalibration::getProgress() const {
+    int done = 0, total = 0;
+    for(int k=0; k<codes.size(); k++) {
+        if(k < current) done += codes[k].size();
+        total += codes[k].size();
+    }
+    return total > 0 ? (float)(done + step) / total : 0;
+}
+
+//RANSAC fit that logs how many correspondences agreed and how well
+static Mat fitHomography(const vector<Point2f> &from, const vector<Point2f> &to, float threshold, const string &name) {
+    Mat inliers;
+    Mat homography = findHomography(Mat(from), Mat(to), CV_RANSAC, threshold, inliers);
+    if(homography.empty()) {
+        ofLogError("AutoCalibration") << "no homography for " << name;
+        return homography;
+    }
+    vector<Point2f> fitted;
+    perspectiveTransform(from, fitted, homography);
+    double squared = 0;
+    int count = 0;
+    for(int i=0; i<from.size(); i++) {
+        if(!inliers.at<uchar>(i)) continue;
+        Point2f d = fitted[i] - to[i];
+        squared += d.x * d.x + d.y * d.y;
+        count++;
+    }
+    ofLogNotice("AutoCalibration") << name << ": " << count << " of " << from.size() << " correspondences, rms "
+        << ofToString(sqrt(squared / MAX(count, 1)), 3) << " px";
+    return homography;
+}
+
+bool AutoCalibration::solve(ProjectorLayout &layout, bool mirror, Mat &homography,
+                            vector<ofVec2f> &cameraCorners, vector<ofVec2f> &warpedCorners) {
+    if(codes.empty()) return false;
+
+    //camera warp: the first output's pixels placed over its part of the warped image
+    vector<ofVec2f> cameraPoints, projectorPoints;
+    const ProjectorRegion &first = layout.regions[regions[0]];
+    if(codes[0].decode(cameraPoints, projectorPoints) < 4) {
+        ofLogError("AutoCalibration") << "no pattern found for " << first.name;
+        return false;
+    }
+    ofRectangle area(first.cameraArea.x * camWidth, first.cameraArea.y * camHeight,
+                     first.cameraArea.width * camWidth, first.cameraArea.height * camHeight);
+    //the stages mirror after warping, so the area is mirrored back here
+    if(mirror) area.x = camWidth - area.x - area.width;
+    vector<Point2f> from, to;
+    for(int i=0; i<cameraPoints.size(); i++) {
+        from.push_back(Point2f(cameraPoints[i].x, cameraPoints[i].y));
+        to.push_back(Point2f(area.x + projectorPoints[i].x * area.width / viewports[0].width,
+                             area.y + projectorPoints[i].y * area.height / viewports[0].height));
+    }
+    Mat warp = fitHomography(from, to, ransacThreshold, first.name + " camera");
+    if(warp.empty()) return false;
+
+    //each output: warped (and mirrored) camera pixels -> its pixels scaled to camera size
+    int solved = 0;
+    for(int k=0; k<regions.size(); k++) {
+        ProjectorRegion &region = layout.regions[regions[k]];
+        if(codes[k].decode(cameraPoints, projectorPoints) < 4) {
+            ofLogWarning("AutoCalibration") << "no pattern found for " << region.name;
+            continue;
+        }
+        vector<Point2f> seen(cameraPoints.size()), warped, projected;
+        for(int i=0; i<cameraPoints.size(); i++) {
+            seen[i] = Point2f(cameraPoints[i].x, cameraPoints[i].y);
+            projected.push_back(Point2f(projectorPoints[i].x * camWidth / viewports[k].width,
+                                        projectorPoints[i].y * camHeight / viewports[k].height));
+        }
+        perspectiveTransform(seen, warped, warp);
+        if(mirror) {
+            for(int i=0; i<warped.size(); i++) warped[i].x = camWidth - 1 - warped[i].x;
+        }
+        Mat output = fitHomography(warped, projected, ransacThreshold, region.name);
+        if(output.empty()) continue;
+
+        //the corners a click would have put on the camera area's corners
+        float x0 = region.cameraArea.x * camWidth, x1 = (region.cameraArea.x + region.cameraArea.width) * camWidth;
+        float y0 = region.cameraArea.y * camHeight, y1 = (region.cameraArea.y + region.cameraArea.height) * camHeight;
+        vector<Point2f> areaCorners, corners;
+        areaCorners.push_back(Point2f(x0, y0));
+        areaCorners.push_back(Point2f(x1, y0));
+        areaCorners.push_back(Point2f(x1, y1));
+        areaCorners.push_back(Point2f(x0, y1));
+        perspectiveTransform(areaCorners, corners, output);
+        region.corners.clear();
+        for(int i=0; i<4; i++) {
+            region.corners.push_back(ofPoint(corners[i].x * region.viewport.width / camWidth + region.viewport.x,
+                                             corners[i].y * region.viewport.height / camHeight + region.viewport.y));
+        }
+        if(region.calibrate(camWidth, camHeight)) solved++;
+    }
+
+    //the same four point pairs the clicked calibration stores
+    vector<Point2f> warpedArea, cameraArea;
+    warpedArea.push_back(Point2f(area.x, area.y));
+    warpedArea.push_back(Point2f(area.x + area.width, area.y));
+    warpedArea.push_back(Point2f(area.x + area.width, area.y + area.height));
+    warpedArea.push_back(Point2f(area.x, area.y + area.height));
+    perspectiveTransform(warpedArea, cameraArea, warp.inv());
+    warpedCorners.clear();
+    cameraCorners.clear();
+    for(int i=0; i<4; i++) {
+        warpedCorners.push_back(ofVec2f(warpedArea[i].x, warpedArea[i].y));
+        cameraCorners.push_back(ofVec2f(cameraArea[i].x, cameraArea[i].y));
+    }
+    homography = warp;
+    return solved > 0;
+}
+
+//what the camera would see of a projected pattern: a little blur, ambient
+//light, less than full contrast and sensor noise
+static void renderCameraView(ofPixels &projected, const Mat &projectorToCamera, int camWidth, int camHeight, ofPixels &seen) {
+    Mat view, noisy, noise(camHeight, camWidth, CV_32F);
+    warpPerspective(toCv(projected), view, projectorToCamera, cv::Size(camWidth, camHeight), INTER_LINEAR);
+    GaussianBlur(view, view, cv::Size(3, 3), 0.8);
+    view.convertTo(noisy, CV_32F, 0.7, 25);
+    randn(noise, 0, 3);
+    noisy += noise;
+    seen.allocate(camWidth, camHeight, OF_PIXELS_GRAY);
+    Mat out = toCv(seen);
+    noisy.convertTo(out, CV_8U);
+}
+
+bool AutoCalibration::runSynthetic(const ProjectorLayout &layout, int camWidth, int camHeight, float &worst) {
+    worst = 0;
+    start(layout, camWidth, camHeight);
+    running = false;
+    int n = regions.size();
+
+    //each output lands in its own slice of the camera image, keystoned a little
+    vector<Mat> truth(n);
+    ofPixels projected, seen;
+    for(int k=0; k<n; k++) {
+        float w = viewports[k].width - 1, h = viewports[k].height - 1;
+        float left = camWidth * (k + 0.1f) / n, right = camWidth * (k + 0.9f) / n;
+        float top = camHeight * 0.1f, bottom = camHeight * 0.9f;
+        float skew = (right - left) * 0.06f;
+        Point2f src[4] = { Point2f(0, 0), Point2f(w, 0), Point2f(w, h), Point2f(0, h) };
+        Point2f dst[4] = { Point2f(left + skew, top), Point2f(right - skew, top + skew), Point2f(right, bottom), Point2f(left, bottom - skew) };
+        truth[k] = getPerspectiveTransform(src, dst);
+        for(int i=0; i<codes[k].size(); i++) {
+            codes[k].render(i, projected);
+            renderCameraView(projected, truth[k], camWidth, camHeight, seen);
+            codes[k].add(i, seen);
+        }
+    }
+
+    ProjectorLayout solved = layout;
+    Mat warp;
+    vector<ofVec2f> cameraCorners, warpedCorners;
+    if(!solve(solved, false, warp, cameraCorners, warpedCorners)) {
+        ofLogError("AutoCalibration") << "synthetic check FAILED: nothing solved";
+        return false;
+    }
+
+    //projector pixel -> camera through the truth, then back through the solution
+    bool passed = n > 0;
+    for(int k=0; k<n; k++) {
+        const ProjectorRegion &region = solved.regions[regions[k]];
+        if(!region.calibrated) {
+            ofLogError("AutoCalibration") << "synthetic " << region.name << " was not calibrated";
+            passed = false;
+            continue;
+        }
+        vector<Point2f> grid, seenGrid, warped, back;
+        for(int gy=0; gy<9; gy++) {
+            for(int gx=0; gx<9; gx++) {
+                grid.push_back(Point2f(viewports[k].width * (gx + 0.5f) / 9, viewports[k].height * (gy + 0.5f) / 9));
+            }
+        }
+        perspectiveTransform(grid, seenGrid, truth[k]);
+        perspectiveTransform(seenGrid, warped, warp);
+        perspectiveTransform(warped, back, region.homography);
+        float sum = 0, regionWorst = 0;
+        for(int i=0; i<grid.size(); i++) {
+            Point2f d(back[i].x * viewports[k].width / camWidth - grid[i].x, back[i].y * viewports[k].height / camHeight - grid[i].y);
+            float error = sqrt(d.x * d.x + d.y * d.y);
+            sum += error;
+            regionWorst = MAX(regionWorst, error);
+        }
+        worst = MAX(worst, regionWorst);
+        if(regionWorst > syntheticTolerance) passed = false;
+        ofLogNotice("AutoCalibration") << "synthetic " << region.name << ": mean error " << ofToString(sum / grid.size(), 2)
+            << " projector px, worst " << ofToString(regionWorst, 2);
+    }
+    if(passed) ofLogNotice("AutoCalibration") << "synthetic check passed, worst " << ofToString(worst, 2) << " px of " << syntheticTolerance;
+    else ofLogError("AutoCalibration") << "synthetic check FAILED, worst " << ofToString(worst, 2) << " px of " << syntheticTolerance;
+    return passed;
+}
+
+//--------------------------------------------------------------
+SyntheticCheck::SyntheticCheck() {
+    camWidth = 320;
+    camHeight = 240;
+    result = 0;
+    worstError = 0;
+}
+
+void SyntheticCheck::start(const AutoCalibration &settings, const ProjectorLayout &layout, int camWidth, int camHeight) {
+    if(isThreadRunning()) return;
+    waitForThread(false);   //the last run's thread is done but not joined
+    calibration = settings;
+    this->layout = layout;
+    this->camWidth = camWidth;
+    this->camHeight = camHeight;
+    startThread();
+}
+
+void SyntheticCheck::stop() {
+    waitForThread(true);
+}
+
+void SyntheticCheck::threadedFunction() {
+    float worst;
+    bool passed = calibration.runSynthetic(layout, camWidth, camHeight, worst);
+    worstError = worst;
+    result = passed ? 1 : -1;
+}
@@ -0,0 +1,119 @@
+//
+//  autoCalibration.h
+//  PS3_Homography
+//
+//  Camera and projector calibration without clicking. Each output in turn
+//  shows white, black and then every bit of a Gray code of its columns and
+//  rows, each followed by its inverse. Comparing a bit with its inverse
+//  tells every lit camera pixel which projector cell it sees, and the
+//  centroid of all the camera pixels of a cell gives one subpixel
+//  correspondence. RANSAC homographies over those give the camera warp and
+//  every output's corners, in the same form the clicked calibration has.
+//
+
+#ifndef PS3_Homography_autoCalibration_h
+#define PS3_Homography_autoCalibration_h
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "projectorLayout.h"
+#include <atomic>
+
+class GrayCodePattern {
+
+public:
+    GrayCodePattern();
+
+    //projector size in pixels, cells are cellSize pixels square
+    void setup(int width, int height, int cellSize);
+    int size() const { return 2 + 2 * (columnBits + rowBits); }
+    //frame index: white, black, then each column bit and its inverse, then the rows
+    void render(int index, ofPixels &out) const;
+
+    void add(int index, const ofPixels &camera);
+    //one camera centroid per decoded cell and the cell centre in projector pixels
+    int decode(vector<ofVec2f> &cameraPoints, vector<ofVec2f> &projectorPoints) const;
+
+    float minContrast;      //white - black below this is a pixel the output doesn't reach
+    float minBitContrast;   //|bit - inverse| below this is a pixel on a stripe edge
+    int   minCellPixels;
+
+private:
+    int readBits(const vector<const unsigned char*> &data, int pixel, int first, int bits) const;
+
+    int width, height, cellSize;
+    int columns, rows, columnBits, rowBits;
+    vector<ofPixels> frames;    //gray camera frames by index
+};
+
+class AutoCalibration {
+
+public:
+    AutoCalibration();
+
+    void start(const ProjectorLayout &layout, int camWidth, int camHeight);
+    void stop();
+    bool isRunning() const { return running; }
+
+    //every new camera frame, returns true once the last output is captured
+    bool addCameraFrame(const ofPixels &camera);
+    //output showing a pattern now (-1 if none) and the pattern, which changes with getPatternVersion
+    int getRegion() const { return running ? regions[current] : -1; }
+    const ofPixels& getPattern() const { return pattern; }
+    int getPatternVersion() const { return patternVersion; }
+    float getProgress() const;
+
+    //camera warp from the first captured output, then every captured output's corners.
+    //the warp comes back as four point pairs too, raw camera -> warped.
+    bool solve(ProjectorLayout &layout, bool mirror, cv::Mat &homography,
+               vector<ofVec2f> &cameraCorners, vector<ofVec2f> &warpedCorners);
+
+    //runs decoding and solving on frames rendered through known homographies and
+    //logs how far the result is from them, in projector pixels. true when every
+    //output comes back within syntheticTolerance; worst is the largest error seen
+    bool runSynthetic(const ProjectorLayout &layout, int camWidth, int camHeight, float &worst);
+
+    int   settleFrames;     //camera frames skipped after each pattern change
+    int   cellSize;         //projector pixels per code cell
+    float ransacThreshold;  //camera pixels
+    float syntheticTolerance;   //projector pixels the synthetic check may be off by
+
+private:
+    void showPattern();
+
+    bool                     running;
+    int                      camWidth, camHeight;
+    vector<int>              regions;
+    vector<ofRectangle>      viewports;
+    vector<GrayCodePattern>  codes;
+    int                      current, step, waiting;
+    ofPixels                 pattern;
+    int                      patternVersion;
+};
+
+//runSynthetic on a copy of the calibration settings, off the main thread
+//so camera frames and drawing carry on while it renders and decodes
+class SyntheticCheck : public ofThread {
+
+public:
+    SyntheticCheck();
+
+    void start(const AutoCalibration &settings, const ProjectorLayout &layout, int camWidth, int camHeight);
+    void stop();
+    bool isBusy() const { return isThreadRunning(); }
+
+    //0 before the first check finished, 1 passed, -1 failed
+    int getResult() const { return result; }
+    float getWorstError() const { return worstError; }
+
+private:
+    void threadedFunction();
+
+    AutoCalibration     calibration;
+    ProjectorLayout     layout;
+    int                 camWidth, camHeight;
+    std::atomic<int>    result;
+    std::atomic<float>  worstError;
+};
+
+#endif
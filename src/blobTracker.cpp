@@ -0,0 +1,219 @@
+//
+//  blobTracker.cpp
+//  PS3_Homography
+//
+
+#include "blobTracker.h"
+
+//cost of leaving a track or a blob unmatched, a matched pair must cost less than two of these
+static const double unmatchedCost = 1.0;
+static const double forbidden = 1e9;
+
+BlobTracker::BlobTracker() {
+    maximumDistance = 32;
+    persistence = 15;
+    areaWeight = 0.5;
+    shapeWeight = 1.0;
+    nextLabel = 0;
+    candidates = 0;
+}
+
+void BlobTracker::reset() {
+    tracks.clear();
+    grid.clear();
+}
+
+//4 pi area / perimeter^2: 1 for a circle, towards 0 for thin or ragged outlines
+float BlobTracker::compactness(const TrackedBlob &blob) {
+    if(blob.perimeter <= 0) return 1;
+    return MIN(1.0f, 4 * PI * blob.area / (blob.perimeter * blob.perimeter));
+}
+
+void BlobTracker::track(vector<TrackedBlob> &blobs) {
+    float cell = MAX(maximumDistance, 1.0f);
+    
+    //hash the tracks by where they should be this frame
+    grid.clear();
+    for(int t=0; t<tracks.size(); t++) {
+        ofVec2f p = tracks[t].centroid + tracks[t].velocity;
+        grid[cellKey(floor(p.x / cell), floor(p.y / cell))].push_back(t);
+    }
+    
+    //candidate pairs from the 3x3 cells around each blob
+    pairs.clear();
+    vector<float> blobCompactness(blobs.size());
+    for(int b=0; b<blobs.size(); b++) {
+        const TrackedBlob &blob = blobs[b];
+        blobCompactness[b] = compactness(blob);
+        int cx = floor(blob.centroid.x / cell), cy = floor(blob.centroid.y / cell);
+        for(int dy=-1; dy<=1; dy++) {
+            for(int dx=-1; dx<=1; dx++) {
+                std::unordered_map<long long, vector<int> >::const_iterator it = grid.find(cellKey(cx + dx, cy + dy));
+                if(it == grid.end()) continue;
+                for(int k=0; k<it->second.size(); k++) {
+                    const Track &track = tracks[it->second[k]];
+                    float distance = blob.centroid.distance(track.centroid + track.velocity) / cell;
+                    if(distance > 1) continue;
+                    double cost = distance
+                        + areaWeight * fabs(log(MAX(blob.area, 1.0f) / MAX(track.area, 1.0f)))
+                        + shapeWeight * fabs(blobCompactness[b] - track.compactness);
+                    if(cost >= 2 * unmatchedCost) continue;
+                    Candidate pair = { it->second[k], b, cost };
+                    pairs.push_back(pair);
+                }
+            }
+        }
+    }
+    candidates = pairs.size();
+    
+    //group tracks and blobs that share candidates (union-find), each group is solved on its own
+    int n = tracks.size() + blobs.size();
+    vector<int> parent(n);
+    for(int i=0; i<n; i++) parent[i] = i;
+    std::function<int(int)> root = [&](int i) { return parent[i] == i ? i : parent[i] = root(parent[i]); };
+    for(int i=0; i<pairs.size(); i++) {
+        parent[root(pairs[i].track)] = root(tracks.size() + pairs[i].blob);
+    }
+    //only groups with a candidate have something to solve, everything else stays unmatched
+    groups.clear();
+    groupOf.assign(n, -1);
+    slot.resize(n);
+    for(int i=0; i<pairs.size(); i++) {
+        int r = root(pairs[i].track);
+        if(groupOf[r] < 0) {
+            groupOf[r] = groups.size();
+            groups.push_back(Group());
+        }
+        groups[groupOf[r]].pairIds.push_back(i);
+    }
+    for(int t=0; t<tracks.size(); t++) {
+        int g = groupOf[root(t)];
+        if(g < 0) continue;
+        slot[t] = groups[g].trackIds.size();
+        groups[g].trackIds.push_back(t);
+    }
+    for(int b=0; b<blobs.size(); b++) {
+        int g = groupOf[root(tracks.size() + b)];
+        if(g < 0) continue;
+        slot[tracks.size() + b] = groups[g].blobIds.size();
+        groups[g].blobIds.push_back(b);
+    }
+    
+    vector<int> match(blobs.size(), -1);    //track index per blob
+    for(int g=0; g<groups.size(); g++) assign(groups[g], match);
+    
+    //update matched tracks, start new ones, age out the lost
+    vector<bool> matched(tracks.size(), false);
+    for(int b=0; b<blobs.size(); b++) {
+        TrackedBlob &blob = blobs[b];
+        if(match[b] >= 0) {
+            Track &track = tracks[match[b]];
+            matched[match[b]] = true;
+            track.velocity = blob.centroid - track.centroid;
+            track.centroid = blob.centroid;
+            track.area = blob.area;
+            track.compactness = blobCompactness[b];
+            track.age++;
+            track.lost = 0;
+            blob.label = track.label;
+            blob.age = track.age;
+            blob.velocity = track.velocity;
+        } else {
+            Track track;
+            track.label = nextLabel++;
+            track.age = 0;
+            track.lost = 0;
+            track.centroid = blob.centroid;
+            track.velocity.set(0, 0);
+            track.area = blob.area;
+            track.compactness = blobCompactness[b];
+            tracks.push_back(track);
+            matched.push_back(true);
+            blob.label = track.label;
+            blob.age = 0;
+            blob.velocity.set(0, 0);
+        }
+    }
+    vector<Track> kept;
+    for(int t=0; t<tracks.size(); t++) {
+        if(!matched[t]) {
+            tracks[t].lost++;
+            tracks[t].centroid += tracks[t].velocity;
+        }
+        if(tracks[t].lost <= persistence) kept.push_back(tracks[t]);
+    }
+    tracks.swap(kept);
+}
+
+//one group: tracks are rows, blobs are columns, padded to a square matrix
+//where every row and column can also go to its own "unmatched" slot
+void BlobTracker::assign(const Group &group, vector<int> &match) {
+    const vector<int> &trackIds = group.trackIds, &blobIds = group.blobIds;
+    int rows = trackIds.size(), cols = blobIds.size();
+    int n = rows + cols;
+    vector<double> cost(n * n, forbidden);
+    for(int i=0; i<group.pairIds.size(); i++) {
+        const Candidate &pair = pairs[group.pairIds[i]];
+        cost[slot[pair.track] * n + slot[tracks.size() + pair.blob]] = pair.cost;
+    }
+    for(int r=0; r<rows; r++) cost[r * n + cols + r] = unmatchedCost;
+    for(int c=0; c<cols; c++) cost[(rows + c) * n + c] = unmatchedCost;
+    for(int r=rows; r<n; r++) {
+        for(int c=cols; c<n; c++) cost[r * n + c] = 0;
+    }
+    
+    vector<int> result = hungarian(cost, n);
+    for(int r=0; r<rows; r++) {
+        int c = result[r];
+        if(c < cols && cost[r * n + c] < forbidden) match[blobIds[c]] = trackIds[r];
+    }
+}
+
+//O(n^3) Hungarian method with row/column potentials
+vector<int> BlobTracker::hungarian(const vector<double> &cost, int n) {
+    vector<double> u(n + 1, 0), v(n + 1, 0), minv(n + 1);
+    vector<int> p(n + 1, 0), way(n + 1, 0);
+    vector<bool> used(n + 1);
+    for(int i=1; i<=n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), std::numeric_limits<double>::infinity());
+        std::fill(used.begin(), used.end(), false);
+        do {
+            used[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            double delta = std::numeric_limits<double>::infinity();
+            for(int j=1; j<=n; j++) {
+                if(used[j]) continue;
+                double cur = cost[(i0 - 1) * n + (j - 1)] - u[i0] - v[j];
+                if(cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if(minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for(int j=0; j<=n; j++) {
+                if(used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while(p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while(j0);
+    }
+    vector<int> result(n, -1);
+    for(int j=1; j<=n; j++) {
+        if(p[j] > 0) result[p[j] - 1] = j - 1;
+    }
+    return result;
+}
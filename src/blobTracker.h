@@ -0,0 +1,71 @@
+//
+//  blobTracker.h
+//  PS3_Homography
+//
+//  Label tracking for many blobs, as an alternative to ofxCv's RectTracker.
+//  Tracks go into a spatial hash by predicted position, so each blob is
+//  only compared with tracks in the neighbouring cells. The candidate
+//  pairs are costed by distance, area change and shape change, and every
+//  connected group of candidates is assigned optimally with the Hungarian
+//  method. Tracks and blobs may also stay unmatched.
+//
+
+#ifndef PS3_Homography_blobTracker_h
+#define PS3_Homography_blobTracker_h
+
+#include "ofMain.h"
+#include "trackingFrame.h"
+#include <unordered_map>
+#include <limits>
+
+class BlobTracker {
+    
+public:
+    BlobTracker();
+    
+    //sets label, age and velocity (pixels per frame) on every blob
+    void track(vector<TrackedBlob> &blobs);
+    //drops every track, new tracks get labels never handed out before
+    void reset();
+    
+    float maximumDistance;  //pixels a blob may move between frames, also the hash cell size
+    int   persistence;      //frames a lost track is kept
+    float areaWeight;       //cost per unit of |log(area ratio)|
+    float shapeWeight;      //cost per unit of compactness change
+    
+    int getTrackCount() const { return tracks.size(); }
+    int getCandidateCount() const { return candidates; }
+    
+    //square cost matrix, returns the column for each row
+    static vector<int> hungarian(const vector<double> &cost, int n);
+    
+private:
+    struct Track {
+        int      label, age, lost;
+        ofVec2f  centroid, velocity;
+        float    area, compactness;
+    };
+    struct Candidate {
+        int      track, blob;
+        double   cost;
+    };
+    //tracks, blobs and candidate pairs connected to each other
+    struct Group {
+        vector<int>  trackIds, blobIds, pairIds;
+    };
+    
+    static long long cellKey(int x, int y) { return ((long long)x << 32) ^ (unsigned int)y; }
+    static float compactness(const TrackedBlob &blob);
+    void assign(const Group &group, vector<int> &match);
+    
+    vector<Track>                                   tracks;
+    vector<Candidate>                               pairs;
+    vector<Group>                                   groups;
+    vector<int>                                     groupOf;    //per root of the union-find
+    vector<int>                                     slot;       //row of a track, column of a blob in its group
+    std::unordered_map<long long, vector<int> >     grid;
+    int                                             nextLabel;  //never reset, other modules cache by label
+    int                                             candidates;
+};
+
+#endif
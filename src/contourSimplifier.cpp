@@ -0,0 +1,129 @@
+//
+//  contourSimplifier.cpp
+//  PS3_Homography
+//
+
+#include "contourSimplifier.h"
+
+static const int maxScaleSteps = 8;
+
+ContourSimplifier::ContourSimplifier() {
+    vertexBudget = 512;
+    minVertices = 4;
+    baseTolerance = 1.0;
+    referenceArea = 2000;
+    velocityGain = 0.25;
+    pixelScale = 1.0;
+    vertexCount = 0;
+    scale = 1.0;
+}
+
+void ContourSimplifier::simplify(vector<TrackedBlob> &blobs) {
+    tolerances.resize(blobs.size());
+    for(int i=0; i<blobs.size(); i++) {
+        float sizeFactor = sqrt(MAX(blobs[i].area, 1.0f) / (referenceArea * pixelScale * pixelScale));
+        float speedFactor = 1.0 + velocityGain * blobs[i].velocity.length() / pixelScale;
+        tolerances[i] = baseTolerance * pixelScale * sizeFactor * speedFactor;
+    }
+    
+    //start from last frame's scale, relaxed a little so detail comes back when blobs leave
+    scale = MAX(1.0f, scale / 1.25f);
+    vertexCount = simplifyAll(blobs, scale);
+    for(int step=0; step<maxScaleSteps && vertexCount > vertexBudget; step++) {
+        scale *= 1.5;
+        vertexCount = simplifyAll(blobs, scale);
+    }
+    
+    //still over budget: thin every outline evenly down to its share
+    if(vertexCount > vertexBudget) {
+        int share = MAX(minVertices, vertexBudget / MAX(1, (int)blobs.size()));
+        vertexCount = 0;
+        for(int i=0; i<blobs.size(); i++) {
+            ofPolyline &poly = blobs[i].simplified;
+            if(poly.size() > share) {
+                vector<ofPoint> thinned;
+                float stride = (float)poly.size() / share;
+                for(int k=0; k<share; k++) thinned.push_back(poly[(int)(k*stride)]);
+                poly.clear();
+                poly.addVertices(thinned);
+                poly.setClosed(true);
+            }
+            vertexCount += poly.size();
+        }
+    }
+}
+
+int ContourSimplifier::simplifyAll(vector<TrackedBlob> &blobs, float s) {
+    int total = 0;
+    vector<ofPoint> out;
+    for(int i=0; i<blobs.size(); i++) {
+        const vector<ofPoint> &in = blobs[i].contour.getVertices();
+        if(in.size() <= minVertices) {
+            out = in;
+        } else {
+            douglasPeucker(in, tolerances[i] * s, out);
+        }
+        blobs[i].simplified.clear();
+        blobs[i].simplified.addVertices(out);
+        blobs[i].simplified.setClosed(true);
+        total += out.size();
+    }
+    return total;
+}
+
+static float segmentDistanceSquared(const ofPoint &p, const ofPoint &a, const ofPoint &b) {
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len = dx*dx + dy*dy;
+    float t = len > 0 ? ((p.x-a.x)*dx + (p.y-a.y)*dy) / len : 0;
+    t = ofClamp(t, 0, 1);
+    float x = a.x + t*dx - p.x, y = a.y + t*dy - p.y;
+    return x*x + y*y;
+}
+
+//closed outline: split at vertex 0 and the vertex farthest from it, then
+//run the usual recursive split (with an explicit stack) on both halves.
+void ContourSimplifier::douglasPeucker(const vector<ofPoint> &in, float tolerance, vector<ofPoint> &out) {
+    out.clear();
+    int n = in.size();
+    if(n < 3) {
+        out = in;
+        return;
+    }
+    
+    int far = 0;
+    float farDist = 0;
+    for(int i=1; i<n; i++) {
+        float d = in[0].squareDistance(in[i]);
+        if(d > farDist) { farDist = d; far = i; }
+    }
+    
+    vector<bool> keep(n, false);
+    keep[0] = keep[far] = true;
+    float tol2 = tolerance * tolerance;
+    
+    //ranges are [first, last] with last possibly == n meaning vertex 0 again
+    vector<pair<int,int> > stack;
+    stack.push_back(make_pair(0, far));
+    stack.push_back(make_pair(far, n));
+    while(!stack.empty()) {
+        int first = stack.back().first, last = stack.back().second;
+        stack.pop_back();
+        const ofPoint &a = in[first];
+        const ofPoint &b = in[last % n];
+        int index = -1;
+        float maxDist = tol2;
+        for(int i=first+1; i<last; i++) {
+            float d = segmentDistanceSquared(in[i], a, b);
+            if(d > maxDist) { maxDist = d; index = i; }
+        }
+        if(index >= 0) {
+            keep[index] = true;
+            stack.push_back(make_pair(first, index));
+            stack.push_back(make_pair(index, last));
+        }
+    }
+    
+    for(int i=0; i<n; i++) {
+        if(keep[i]) out.push_back(in[i]);
+    }
+}
@@ -0,0 +1,48 @@
+//
+//  contourSimplifier.h
+//  PS3_Homography
+//
+//  Douglas-Peucker simplification of every tracked outline under one
+//  vertex budget shared by the whole frame. Each blob's tolerance grows
+//  with its size and speed; if the frame still goes over budget all
+//  tolerances are scaled up together.
+//
+
+#ifndef PS3_Homography_contourSimplifier_h
+#define PS3_Homography_contourSimplifier_h
+
+#include "ofMain.h"
+#include "trackingFrame.h"
+
+class ContourSimplifier {
+    
+public:
+    ContourSimplifier();
+    
+    //fills blob.simplified for every blob
+    void simplify(vector<TrackedBlob> &blobs);
+    
+    //forgets the scale carried over from earlier frames
+    void reset() { scale = 1.0; vertexCount = 0; }
+    
+    int getVertexCount() const { return vertexCount; }
+    float getScale() const { return scale; }
+    
+    int   vertexBudget;     //total vertices across all outlines in a frame
+    int   minVertices;      //per outline floor
+    float baseTolerance;    //pixels, for a still blob of referenceArea
+    float referenceArea;
+    float velocityGain;     //extra tolerance per pixel/frame of speed
+    float pixelScale;       //camera width / 320, the values above are tuned for 320x240
+    
+    static void douglasPeucker(const vector<ofPoint> &in, float tolerance, vector<ofPoint> &out);
+    
+private:
+    int simplifyAll(vector<TrackedBlob> &blobs, float s);
+    
+    vector<float> tolerances;
+    int   vertexCount;
+    float scale;
+};
+
+#endif
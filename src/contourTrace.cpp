@@ -0,0 +1,183 @@
+//
+//  contourTrace.cpp
+//  PS3_Homography
+//
+//  frame layout: uint64 captureMicros, uint16 eventBytes, uint16 blobCount,
+//  the events (uint8 PhysicsEvent, PHYSICS_DROP_CIRCLE followed by int16 x, y),
+//  then per blob: int32 label, int32 age, 7 x float
+//  (centroid, velocity, area, center), uint16 vertexCount, vertexCount x
+//  (int16 x, int16 y).
+//
+
+#include "contourTrace.h"
+
+static const uint32_t traceMagic = 0x52545053;     //"SPTR"
+static const uint32_t traceVersion = 2;
+//version 1 had no events with a position, so its event bytes read the same
+static const uint32_t oldestTraceVersion = 1;
+
+template<typename T> static void put(vector<char> &buffer, const T &value) {
+    const char *bytes = (const char*)&value;
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T> static bool get(std::ifstream &in, T &value) {
+    in.read((char*)&value, sizeof(T));
+    return (bool)in;
+}
+
+ContourTraceWriter::ContourTraceWriter() {
+    frames = 0;
+}
+
+ContourTraceWriter::~ContourTraceWriter() {
+    close();
+}
+
+bool ContourTraceWriter::open(const string &path, uint32_t seed, int camWidth, int camHeight) {
+    close();
+    out.open(ofToDataPath(path, true).c_str(), std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        ofLogError("ContourTrace") << "couldn't open " << path << " for writing";
+        return false;
+    }
+    ContourTraceHeader header;
+    header.magic = traceMagic;
+    header.version = traceVersion;
+    header.seed = seed;
+    header.camWidth = camWidth;
+    header.camHeight = camHeight;
+    out.write((const char*)&header, sizeof(header));
+    frames = 0;
+    events.clear();
+    return true;
+}
+
+void ContourTraceWriter::close() {
+    if(out.is_open()) out.close();
+}
+
+void ContourTraceWriter::addEvent(const TraceEvent &event) {
+    if(!out.is_open()) return;
+    events.push_back(event.type);
+    if(event.type == PHYSICS_DROP_CIRCLE) {
+        int16_t xy[2] = { (int16_t)roundf(event.at.x), (int16_t)roundf(event.at.y) };
+        const uint8_t *bytes = (const uint8_t*)xy;
+        events.insert(events.end(), bytes, bytes + sizeof(xy));
+    }
+}
+
+void ContourTraceWriter::writeFrame(const TrackingFrame &frame) {
+    if(!out.is_open()) return;
+    buffer.clear();
+    put(buffer, (uint64_t)frame.captureMicros);
+    put(buffer, (uint16_t)events.size());
+    put(buffer, (uint16_t)frame.blobs.size());
+    buffer.insert(buffer.end(), events.begin(), events.end());
+    for(int i=0; i<frame.blobs.size(); i++) {
+        const TrackedBlob &blob = frame.blobs[i];
+        put(buffer, (int32_t)blob.label);
+        put(buffer, (int32_t)blob.age);
+        put(buffer, blob.centroid.x);
+        put(buffer, blob.centroid.y);
+        put(buffer, blob.velocity.x);
+        put(buffer, blob.velocity.y);
+        put(buffer, blob.area);
+        put(buffer, blob.center.x);
+        put(buffer, blob.center.y);
+        const vector<ofPoint> &verts = blob.contour.getVertices();
+        uint16_t count = MIN(verts.size(), (size_t)0xffff);
+        put(buffer, count);
+        for(int k=0; k<count; k++) {
+            put(buffer, (int16_t)roundf(verts[k].x));
+            put(buffer, (int16_t)roundf(verts[k].y));
+        }
+    }
+    out.write(&buffer[0], buffer.size());
+    events.clear();
+    frames++;
+}
+
+//--------------------------------------------------------------
+ContourTraceReader::ContourTraceReader() {
+    memset(&header, 0, sizeof(header));
+}
+
+bool ContourTraceReader::open(const string &path) {
+    close();
+    in.open(ofToDataPath(path, true).c_str(), std::ios::binary);
+    if(!in.is_open()) {
+        ofLogError("ContourTrace") << "couldn't open " << path;
+        return false;
+    }
+    if(!get(in, header) || header.magic != traceMagic
+       || header.version < oldestTraceVersion || header.version > traceVersion) {
+        ofLogError("ContourTrace") << path << " is not a version " << traceVersion << " contour trace";
+        close();
+        return false;
+    }
+    firstFrame = in.tellg();
+    return true;
+}
+
+void ContourTraceReader::close() {
+    if(in.is_open()) in.close();
+}
+
+void ContourTraceReader::rewind() {
+    in.clear();
+    in.seekg(firstFrame);
+}
+
+bool ContourTraceReader::readFrame(TrackingFrame &frame, vector<TraceEvent> &events) {
+    if(!in.is_open()) return false;
+    uint64_t micros;
+    uint16_t eventCount, blobCount;
+    if(!get(in, micros) || !get(in, eventCount) || !get(in, blobCount)) return false;
+    eventBytes.resize(eventCount);
+    if(eventCount > 0) in.read((char*)&eventBytes[0], eventCount);
+    events.clear();
+    for(int i=0; i<eventBytes.size(); i++) {
+        TraceEvent event((PhysicsEvent)eventBytes[i]);
+        if(event.type == PHYSICS_DROP_CIRCLE) {
+            int16_t xy[2];
+            if(i + 1 + sizeof(xy) > eventBytes.size()) break;
+            memcpy(xy, &eventBytes[i+1], sizeof(xy));
+            event.at.set(xy[0], xy[1]);
+            i += sizeof(xy);
+        }
+        events.push_back(event);
+    }
+    
+    frame.sequence++;
+    frame.captureMicros = micros;
+    frame.blobs.resize(blobCount);
+    for(int i=0; i<blobCount; i++) {
+        TrackedBlob &blob = frame.blobs[i];
+        int32_t label, age;
+        uint16_t count;
+        get(in, label);
+        get(in, age);
+        get(in, blob.centroid.x);
+        get(in, blob.centroid.y);
+        get(in, blob.velocity.x);
+        get(in, blob.velocity.y);
+        get(in, blob.area);
+        get(in, blob.center.x);
+        get(in, blob.center.y);
+        if(!get(in, count)) return false;
+        blob.label = label;
+        blob.age = age;
+        blob.contour.clear();
+        for(int k=0; k<count; k++) {
+            int16_t x, y;
+            get(in, x);
+            get(in, y);
+            blob.contour.addVertex(x, y);
+        }
+        blob.contour.setClosed(true);
+        blob.bounds = blob.contour.getBoundingBox();
+        blob.perimeter = blob.contour.getPerimeter();
+    }
+    return (bool)in;
+}
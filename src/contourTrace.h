@@ -0,0 +1,89 @@
+//
+//  contourTrace.h
+//  PS3_Homography
+//
+//  Compact binary recording of what the tracker produced each frame
+//  (label, centroid, velocity, area and the outline as 16 bit pixel
+//  coordinates) plus the physics events fired from the gui, so the box2d
+//  side can be replayed and benchmarked without a camera.
+//
+
+#ifndef PS3_Homography_contourTrace_h
+#define PS3_Homography_contourTrace_h
+
+#include "ofMain.h"
+#include "trackingFrame.h"
+#include <stdint.h>
+#include <fstream>
+
+//physics actions that can come from the gui or keys, recorded so a replay repeats them
+enum PhysicsEvent {
+    PHYSICS_ADD_CIRCLE = 1,
+    PHYSICS_ADD_PARTICLES,
+    PHYSICS_CLEAR_SHAPES,
+    PHYSICS_GRAVITY_ON,
+    PHYSICS_GRAVITY_OFF,
+    PHYSICS_WALLS_ON,
+    PHYSICS_WALLS_OFF,
+    PHYSICS_CLEAR_CIRCLES,      //'c'
+    PHYSICS_DROP_CIRCLE         //'1', at a window position
+};
+
+struct TraceEvent {
+    TraceEvent(PhysicsEvent _type = PHYSICS_ADD_CIRCLE, const ofPoint &_at = ofPoint()) : type(_type), at(_at) {}
+    PhysicsEvent type;
+    ofPoint      at;            //PHYSICS_DROP_CIRCLE only
+};
+
+struct ContourTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seed;          //ofSeedRandom value used while recording
+    uint16_t camWidth, camHeight;
+};
+
+class ContourTraceWriter {
+    
+public:
+    ContourTraceWriter();
+    ~ContourTraceWriter();
+    
+    bool open(const string &path, uint32_t seed, int camWidth, int camHeight);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+    
+    //events collected since the last frame are written with the next one
+    void addEvent(const TraceEvent &event);
+    void writeFrame(const TrackingFrame &frame);
+    
+    int getFrameCount() const { return frames; }
+    
+private:
+    std::ofstream     out;
+    vector<uint8_t>   events;
+    vector<char>      buffer;
+    int               frames;
+};
+
+class ContourTraceReader {
+    
+public:
+    ContourTraceReader();
+    
+    bool open(const string &path);
+    void close();
+    void rewind();
+    
+    //returns false at the end of the trace
+    bool readFrame(TrackingFrame &frame, vector<TraceEvent> &events);
+    
+    const ContourTraceHeader& getHeader() const { return header; }
+    
+private:
+    std::ifstream       in;
+    ContourTraceHeader  header;
+    std::streampos      firstFrame;
+    vector<uint8_t>     eventBytes;
+};
+
+#endif
@@ -0,0 +1,99 @@
+//
+//  frameExporter.cpp
+//  PS3_Homography
+//
+
+#include "frameExporter.h"
+
+static const uint32_t exportMagic = 0x4d465053;   //"SPFM"
+
+FrameExporter::FrameExporter() {
+    enabled = false;
+    slots = 4;
+    for(int i=0; i<EXPORT_STREAM_COUNT; i++) ringBytes[i] = 0;
+}
+
+FrameExporter::~FrameExporter() {
+    close();
+}
+
+string FrameExporter::streamName(const string &prefix, ExportStream stream) {
+    static const char *names[EXPORT_STREAM_COUNT] = { "camera", "warped", "mask" };
+    return prefix + "." + names[stream];
+}
+
+void FrameExporter::setup(const string &_prefix, int _slots) {
+    std::unique_lock<std::mutex> guard(lock);
+    closeRings();
+    prefix = _prefix;
+    slots = _slots;
+    enabled = true;
+    ofLogNotice("FrameExporter") << "exporting frames to shared memory /" << prefix << ".*";
+}
+
+void FrameExporter::close() {
+    std::unique_lock<std::mutex> guard(lock);
+    closeRings();
+}
+
+void FrameExporter::closeRings() {
+    for(int i=0; i<EXPORT_STREAM_COUNT; i++) {
+        rings[i].close();
+        ringBytes[i] = 0;
+    }
+    enabled = false;
+}
+
+void FrameExporter::publish(ExportStream stream, const ofPixels &pixels, uint64_t frameNumber, uint64_t captureMicros) {
+    if(!enabled || !pixels.isAllocated()) return;
+    std::unique_lock<std::mutex> guard(lock);
+    if(!enabled) return;
+    
+    size_t bytes = sizeof(ExportFrameHeader) + pixels.getTotalBytes();
+    SharedRing &ring = rings[stream];
+    if(ringBytes[stream] != bytes) {
+        //readers move to the new segment on their next read
+        if(!ring.create(streamName(prefix, stream), slots, bytes)) {
+            closeRings();
+            return;
+        }
+        ringBytes[stream] = bytes;
+    }
+    
+    unsigned char *slot = ring.beginWrite();
+    ExportFrameHeader *header = (ExportFrameHeader*)slot;
+    header->magic = exportMagic;
+    header->width = pixels.getWidth();
+    header->height = pixels.getHeight();
+    header->channels = pixels.getNumChannels();
+    header->reserved = 0;
+    header->bytesPerRow = pixels.getWidth() * pixels.getBytesPerPixel();
+    header->frameNumber = frameNumber;
+    header->captureMicros = captureMicros;
+    memcpy(slot + sizeof(ExportFrameHeader), pixels.getData(), pixels.getTotalBytes());
+    ring.endWrite(bytes, captureMicros, stream);
+}
+
+//--------------------------------------------------------------
+bool FrameExportReader::open(const string &prefix, ExportStream stream) {
+    current = NULL;
+    return ring.open(FrameExporter::streamName(prefix, stream));
+}
+
+const unsigned char* FrameExportReader::acquire(ExportFrameHeader &header) {
+    size_t bytes;
+    uint64_t timestamp;
+    uint32_t tag;
+    current = ring.peekLatest(sequence, bytes, timestamp, tag);
+    if(current == NULL || bytes < sizeof(ExportFrameHeader)) return NULL;
+    memcpy(&header, current, sizeof(ExportFrameHeader));
+    if(header.magic != exportMagic) return NULL;
+    return current + sizeof(ExportFrameHeader);
+}
+
+bool FrameExportReader::release() {
+    //false means the writer reused the slot while it was being read
+    bool valid = current != NULL && ring.validate(current, sequence);
+    current = NULL;
+    return valid;
+}
@@ -0,0 +1,86 @@
+//
+//  frameExporter.h
+//  PS3_Homography
+//
+//  Publishes the camera, warped and tracking mask frames into one
+//  SharedRing per stream so other tools on the show machine can use the
+//  PS3 Eye feed without opening the camera. Writing is a single memcpy
+//  into the next slot and never waits on readers; readers map the ring
+//  and use the newest slot in place, checking its seqlock afterwards.
+//
+//  rings are named <prefix>.camera, <prefix>.warped and <prefix>.mask,
+//  every slot starts with an ExportFrameHeader followed by the pixels.
+//  the camera stream is published from the update thread and the others
+//  from the track stage, so every call takes the exporter's lock.
+//
+
+#ifndef PS3_Homography_frameExporter_h
+#define PS3_Homography_frameExporter_h
+
+#include "ofMain.h"
+#include "sharedRing.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+enum ExportStream {
+    EXPORT_CAMERA = 0,
+    EXPORT_WARPED,
+    EXPORT_MASK,
+    EXPORT_STREAM_COUNT
+};
+
+struct ExportFrameHeader {
+    uint32_t magic;
+    uint16_t width, height;
+    uint16_t channels;        //1 = mask, 3 = rgb, 4 = rgba
+    uint16_t reserved;
+    uint32_t bytesPerRow;
+    uint64_t frameNumber;
+    uint64_t captureMicros;
+};
+
+class FrameExporter {
+    
+public:
+    FrameExporter();
+    ~FrameExporter();
+    
+    void setup(const string &prefix, int slots = 4);
+    void close();
+    bool isEnabled() const { return enabled; }
+    
+    //rings are (re)created on the first frame of a new size
+    void publish(ExportStream stream, const ofPixels &pixels, uint64_t frameNumber, uint64_t captureMicros);
+    
+    static string streamName(const string &prefix, ExportStream stream);
+    
+private:
+    void closeRings();      //with lock held
+    
+    std::mutex          lock;
+    std::atomic<bool>   enabled;
+    string      prefix;
+    int         slots;
+    SharedRing  rings[EXPORT_STREAM_COUNT];
+    size_t      ringBytes[EXPORT_STREAM_COUNT];
+};
+
+//other processes use this to read a stream in place
+class FrameExportReader {
+    
+public:
+    bool open(const string &prefix, ExportStream stream);
+    void close() { ring.close(); }
+    
+    //newest frame or NULL; pixels stay valid until release() says otherwise
+    const unsigned char* acquire(ExportFrameHeader &header);
+    bool release();
+    
+private:
+    SharedRing            ring;
+    const unsigned char*  current;
+    uint64_t              sequence;
+};
+
+#endif
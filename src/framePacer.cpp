@@ -0,0 +1,115 @@
+//
+//  framePacer.cpp
+//  PS3_Homography
+//
+
+#include "framePacer.h"
+
+//a late camera frame is looked for this often until it shows up
+static const double pollInterval = 0.001;
+//wake a little before a camera frame is due, the grabber's thread may deliver early
+static const double cameraMargin = 0.0005;
+
+FramePacer::FramePacer() {
+    enabled = true;
+    physicsActive = true;
+    physicsRate = 120;
+    maxSteps = 4;
+    idleRate = 10;
+    maxPresentRate = 120;
+    notified = false;
+    changed = true;
+    cameraPeriod = 0;
+    lastCamera = 0;
+    nextStep = 0;
+    lastPresent = 0;
+    droppedSteps = 0;
+    rateStart = 0;
+    wakes = presents = 0;
+    wakeRate = presentRate = 0;
+}
+
+double FramePacer::now() {
+    return ofGetElapsedTimeMicros() * 1e-6;
+}
+
+void FramePacer::wait() {
+    double start = now();
+    if(enabled) {
+        double due = lastPresent + 1.0 / idleRate;
+        if(changed) due = MIN(due, lastPresent + 1.0 / maxPresentRate);
+        if(physicsActive) due = MIN(due, nextStep);
+        //the next camera frame one period after the last, a late one is polled for
+        //until it is three periods late and the camera counts as stalled
+        if(cameraPeriod > 0 && start - lastCamera < cameraPeriod * 3) {
+            due = MIN(due, MAX(lastCamera + cameraPeriod - cameraMargin, start + pollInterval));
+        }
+        std::unique_lock<std::mutex> guard(mutex);
+        if(!notified && due > start) {
+            wake.wait_for(guard, std::chrono::microseconds((long long)((due - start) * 1e6)), [this] { return notified; });
+        }
+        notified = false;
+    }
+    count(now());
+}
+
+void FramePacer::notify() {
+    std::unique_lock<std::mutex> guard(mutex);
+    notified = true;
+    wake.notify_one();
+}
+
+void FramePacer::cameraFrame() {
+    double time = now();
+    if(lastCamera > 0) {
+        double interval = time - lastCamera;
+        //a dropped frame shouldn't throw the period off, a new camera mode gets there in a few frames
+        if(cameraPeriod > 0) interval = ofClamp(interval, cameraPeriod * 0.5, cameraPeriod * 2);
+        cameraPeriod = cameraPeriod > 0 ? cameraPeriod * 0.9 + interval * 0.1 : interval;
+    }
+    lastCamera = time;
+}
+
+int FramePacer::physicsSteps() {
+    if(!enabled) return 1;
+    double time = now(), interval = 1.0 / physicsRate;
+    if(nextStep == 0) nextStep = time;
+    int steps = 0;
+    while(time >= nextStep && steps < maxSteps) {
+        steps++;
+        nextStep += interval;
+    }
+    //too far behind to catch up: skip ahead rather than step in bursts
+    if(time >= nextStep) {
+        if(physicsActive) droppedSteps += (unsigned long long)((time - nextStep) / interval) + 1;
+        nextStep = time + interval;
+    }
+    return steps;
+}
+
+void FramePacer::markChanged() {
+    changed = true;
+}
+
+bool FramePacer::shouldPresent() const {
+    if(!enabled) return true;
+    double since = now() - lastPresent;
+    if(since >= 1.0 / idleRate) return true;
+    return changed && since >= 1.0 / maxPresentRate;
+}
+
+void FramePacer::presented() {
+    changed = false;
+    lastPresent = now();
+    presents++;
+}
+
+void FramePacer::count(double time) {
+    wakes++;
+    if(time - rateStart >= 1) {
+        wakeRate = wakes / (time - rateStart);
+        presentRate = presents / (time - rateStart);
+        wakes = presents = 0;
+        rateStart = time;
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  framePacer.h
+//  PS3_Homography
+//
+//  Decides when the main loop wakes and what it does once awake, instead
+//  of running it flat out at a fixed frame rate. The loop sleeps until the
+//  next camera frame is due, the next physics step is due, a tracked frame
+//  comes out of the pipeline or the display deadline passes. Physics steps
+//  on its own fixed clock, and the scene is only redrawn when something it
+//  shows has changed or at the idle rate, so the stats keep moving.
+//
+
+#ifndef PS3_Homography_framePacer_h
+#define PS3_Homography_framePacer_h
+
+#include "ofMain.h"
+#include <condition_variable>
+
+class FramePacer {
+
+public:
+    FramePacer();
+
+    //blocks the main thread until something is due or notify is called
+    void wait();
+    //any thread: a tracked frame is ready
+    void notify();
+
+    void cameraFrame();     //a new camera frame was taken
+    int  physicsSteps();    //steps due since the last call, at most maxSteps
+    void markChanged();     //something on screen changed
+    bool shouldPresent() const;
+    void presented();
+
+    float getCameraPeriodMs() const { return cameraPeriod * 1000; }
+    float getWakeRate() const { return wakeRate; }
+    float getPresentRate() const { return presentRate; }
+    unsigned long long getDroppedSteps() const { return droppedSteps; }
+
+    bool  enabled;          //off: no waiting, one physics step per loop and a redraw every loop
+    bool  physicsActive;    //set by the app, nothing awake means the physics clock doesn't wake the loop
+    float physicsRate;      //physics steps per second
+    int   maxSteps;         //steps per wake, the rest is dropped when the loop falls behind
+    float idleRate;         //redraws per second when nothing changes
+    float maxPresentRate;   //redraws per second at most, changes in between are batched
+
+private:
+    static double now();
+    void count(double time);
+
+    std::mutex              mutex;
+    std::condition_variable wake;
+    bool                    notified, changed;
+    double                  cameraPeriod, lastCamera, nextStep, lastPresent;
+    unsigned long long      droppedSteps;
+
+    //rates over the last second
+    double                  rateStart;
+    int                     wakes, presents;
+    float                   wakeRate, presentRate;
+};
+
+#endif
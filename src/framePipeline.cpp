@@ -0,0 +1,252 @@
+//
+//  framePipeline.cpp
+//  PS3_Homography
+//
+
+#include "framePipeline.h"
+
+static thread_local int currentWorker = -1;
+
+WorkStealingPool::WorkStealingPool() {
+    pending = 0;
+    next = 0;
+    steals = 0;
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    stop();
+}
+
+void WorkStealingPool::start(int numWorkers) {
+    stop();
+    for(int i=0; i<numWorkers; i++) {
+        shared_ptr<Worker> worker(new Worker);
+        worker->pool = this;
+        worker->index = i;
+        workers.push_back(worker);
+    }
+    for(int i=0; i<workers.size(); i++) workers[i]->startThread();
+}
+
+void WorkStealingPool::stop() {
+    for(int i=0; i<workers.size(); i++) workers[i]->stopThread();
+    wake.notify_all();
+    for(int i=0; i<workers.size(); i++) workers[i]->waitForThread(false);
+    workers.clear();
+    pending = 0;
+}
+
+void WorkStealingPool::submit(const std::function<void()> &task) {
+    if(workers.empty()) {
+        task();
+        return;
+    }
+    int index = currentWorker >= 0 ? currentWorker : next++ % workers.size();
+    {
+        std::unique_lock<std::mutex> guard(workers[index]->tasksMutex);
+        workers[index]->tasks.push_back(task);
+    }
+    pending++;
+    wake.notify_one();
+}
+
+bool WorkStealingPool::take(int index, std::function<void()> &task) {
+    {
+        Worker &own = *workers[index];
+        std::unique_lock<std::mutex> guard(own.tasksMutex);
+        if(!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for(int i=1; i<workers.size(); i++) {
+        Worker &victim = *workers[(index + i) % workers.size()];
+        std::unique_lock<std::mutex> guard(victim.tasksMutex);
+        if(!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::Worker::threadedFunction() {
+    currentWorker = index;
+    std::function<void()> task;
+    while(isThreadRunning()) {
+        if(pool->take(index, task)) {
+            pool->pending--;
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(pool->sleepMutex);
+        pool->wake.wait_for(guard, std::chrono::milliseconds(10), [this]{ return pool->pending > 0 || !isThreadRunning(); });
+    }
+}
+
+//--------------------------------------------------------------
+FramePipeline::FramePipeline() {
+    policy = PIPELINE_LATENCY;
+    paused = false;
+    running = false;
+    output.name = "physics";
+}
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+void FramePipeline::addStage(const string &name, const StageFunction &function) {
+    Stage stage;
+    stage.name = name;
+    stage.function = function;
+    stages.push_back(stage);
+}
+
+void FramePipeline::start(int numWorkers) {
+    pool.start(numWorkers);
+    std::unique_lock<std::mutex> guard(lock);
+    running = true;
+}
+
+void FramePipeline::stop() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if(!running) return;
+        running = false;
+    }
+    pause();
+    pool.stop();
+}
+
+void FramePipeline::setPolicy(PipelinePolicy _policy) {
+    std::unique_lock<std::mutex> guard(lock);
+    if(policy == _policy) return;
+    policy = _policy;
+    //a queue deeper than the new capacity is trimmed from the old end
+    for(int i=0; i<=stages.size(); i++) {
+        Stage &stage = i < stages.size() ? stages[i] : output;
+        while(stage.input.size() > capacity()) {
+            stage.input.pop_front();
+            stage.dropped++;
+        }
+    }
+    for(int i=0; i<stages.size(); i++) schedule(i);
+}
+
+void FramePipeline::enqueue(Stage &target, const PipelineFramePtr &frame) {
+    //only LATENCY gets here with a full queue, the waiting frame is stale
+    if(target.input.size() >= capacity()) {
+        target.input.pop_front();
+        target.dropped++;
+    }
+    target.input.push_back(frame);
+    target.maxDepth = MAX(target.maxDepth, (int)target.input.size());
+}
+
+bool FramePipeline::push(const PipelineFramePtr &frame) {
+    std::unique_lock<std::mutex> guard(lock);
+    if(stages.empty() || !running) return false;
+    Stage &first = stages[0];
+    if(policy == PIPELINE_THROUGHPUT && first.input.size() >= capacity()) {
+        first.dropped++;
+        return false;
+    }
+    enqueue(first, frame);
+    schedule(0);
+    return true;
+}
+
+PipelineFramePtr FramePipeline::pop() {
+    std::unique_lock<std::mutex> guard(lock);
+    if(output.input.empty()) return PipelineFramePtr();
+    PipelineFramePtr frame;
+    if(policy == PIPELINE_LATENCY) {
+        frame = output.input.back();
+        output.dropped += output.input.size() - 1;
+        output.input.clear();
+    } else {
+        frame = output.input.front();
+        output.input.pop_front();
+    }
+    output.processed++;
+    if(!stages.empty()) schedule(stages.size() - 1);
+    return frame;
+}
+
+void FramePipeline::schedule(int index) {
+    Stage &stage = stages[index];
+    if(paused || !running || stage.busy || stage.input.empty()) return;
+    //throughput holds the stage back instead of dropping downstream
+    Stage &downstream = index + 1 < stages.size() ? stages[index + 1] : output;
+    if(policy == PIPELINE_THROUGHPUT && downstream.input.size() >= capacity()) return;
+    
+    stage.busy = true;
+    PipelineFramePtr frame = stage.input.front();
+    stage.input.pop_front();
+    pool.submit([this, index, frame] { run(index, frame); });
+}
+
+void FramePipeline::run(int index, PipelineFramePtr frame) {
+    //the stage is marked busy, so nobody else touches its function or state
+    unsigned long long start = ofGetElapsedTimeMicros();
+    stages[index].function(*frame);
+    float ms = (ofGetElapsedTimeMicros() - start) / 1000.0;
+    
+    std::unique_lock<std::mutex> guard(lock);
+    Stage &stage = stages[index];
+    stage.meanMs = stage.processed == 0 ? ms : stage.meanMs * 0.95 + ms * 0.05;
+    stage.processed++;
+    stage.busy = false;
+    enqueue(index + 1 < stages.size() ? stages[index + 1] : output, frame);
+    schedule(index);
+    if(index + 1 < stages.size()) schedule(index + 1);
+    if(index > 0) schedule(index - 1);
+    idle.notify_all();
+    guard.unlock();
+    if(index + 1 == stages.size() && outputListener) outputListener();
+}
+
+void FramePipeline::pause() {
+    std::unique_lock<std::mutex> guard(lock);
+    paused = true;
+    idle.wait(guard, [this] {
+        for(int i=0; i<stages.size(); i++) {
+            if(stages[i].busy) return false;
+        }
+        return true;
+    });
+}
+
+void FramePipeline::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    for(int i=0; i<stages.size(); i++) stages[i].input.clear();
+    output.input.clear();
+}
+
+void FramePipeline::resume() {
+    std::unique_lock<std::mutex> guard(lock);
+    paused = false;
+    for(int i=0; i<stages.size(); i++) schedule(i);
+}
+
+vector<StageStats> FramePipeline::getStats() const {
+    std::unique_lock<std::mutex> guard(lock);
+    vector<StageStats> stats;
+    for(int i=0; i<=stages.size(); i++) {
+        const Stage &stage = i < stages.size() ? stages[i] : output;
+        StageStats s;
+        s.name = stage.name;
+        s.depth = stage.input.size();
+        s.maxDepth = stage.maxDepth;
+        s.capacity = capacity();
+        s.processed = stage.processed;
+        s.dropped = stage.dropped;
+        s.meanMs = stage.meanMs;
+        stats.push_back(s);
+    }
+    return stats;
+}
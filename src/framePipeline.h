@@ -0,0 +1,163 @@
+//
+//  framePipeline.h
+//  PS3_Homography
+//
+//  The per camera frame work as a chain of stages with bounded queues in
+//  between. Each stage handles one frame at a time in order, but different
+//  stages work on different frames at the same time: while frame N is
+//  warped, frame N-1 is tracked and the app simulates frame N-2. Stages run
+//  as tasks on a small work-stealing pool. The app pushes captured frames
+//  in and pops finished ones out on the main thread, where the GL and
+//  Box2D work stays.
+//
+//  LATENCY keeps one frame per queue and replaces a waiting frame with a
+//  newer one, so what comes out is always the freshest frame. THROUGHPUT
+//  keeps deeper queues and never drops a frame once it is in the pipeline;
+//  a full pipeline holds upstream stages back and drops at the entry.
+//
+
+#ifndef PS3_Homography_framePipeline_h
+#define PS3_Homography_framePipeline_h
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "trackingFrame.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+//everything one camera frame carries through the stages
+struct PipelineFrame {
+    PipelineFrame() : sequence(0), captureMicros(0), mirror(false), wantDistance(false), wantOutlines(true), blurSize(5), vertexBudget(0), pixelScale(1), vertexCount(0), puppetTemplates(0), puppetLookups(0), puppetMs(0) {}
+    unsigned long long  sequence, captureMicros;
+    
+    //stamped by the app on capture, so stages don't read app state
+    ofPixels            camera;
+    cv::Mat             homography;
+    bool                mirror, wantDistance;
+    bool                wantOutlines;   //trace every outline, not just those in outlineAreas
+    vector<ofRectangle> outlineAreas;   //camera pixels, blobs centred here become bodies
+    int                 blurSize, vertexBudget;
+    float               pixelScale;     //camera width / 320
+    string              teachPuppet;    //add the largest blob to the puppet library under this name
+    
+    //filled in by the stages
+    ofPixels            warped, mask;
+    cv::Mat             distance;       //signed distance to the shadows, when wanted
+    TrackingFrame       tracked;
+    int                 vertexCount;
+    int                 puppetTemplates, puppetLookups;
+    float               puppetMs;
+};
+typedef shared_ptr<PipelineFrame> PipelineFramePtr;
+
+enum PipelinePolicy {
+    PIPELINE_LATENCY = 0,
+    PIPELINE_THROUGHPUT
+};
+
+class WorkStealingPool {
+    
+public:
+    WorkStealingPool();
+    ~WorkStealingPool();
+    
+    void start(int numWorkers);
+    void stop();
+    //from a worker the task goes on that worker's own deque, otherwise round robin
+    void submit(const std::function<void()> &task);
+    
+    int getNumWorkers() const { return workers.size(); }
+    unsigned long long getSteals() const { return steals; }
+    
+private:
+    class Worker : public ofThread {
+    public:
+        void threadedFunction();
+        WorkStealingPool*                   pool;
+        int                                 index;
+        std::mutex                          tasksMutex;
+        std::deque<std::function<void()> >  tasks;
+    };
+    
+    //own deque from the back, others from the front
+    bool take(int index, std::function<void()> &task);
+    
+    vector<shared_ptr<Worker> >         workers;
+    std::mutex                          sleepMutex;
+    std::condition_variable             wake;
+    std::atomic<int>                    pending;
+    std::atomic<unsigned int>           next;
+    std::atomic<unsigned long long>     steals;
+};
+
+struct StageStats {
+    string              name;
+    int                 depth, maxDepth, capacity;
+    unsigned long long  processed, dropped;
+    float               meanMs;
+};
+
+class FramePipeline {
+    
+public:
+    typedef std::function<void(PipelineFrame&)> StageFunction;
+    
+    FramePipeline();
+    ~FramePipeline();
+    
+    //stages run in the order they are added, add them all before start
+    void addStage(const string &name, const StageFunction &function);
+    void start(int numWorkers);
+    void stop();
+    
+    void setPolicy(PipelinePolicy policy);
+    PipelinePolicy getPolicy() const { return policy; }
+    
+    //false if the frame was dropped at the entry
+    bool push(const PipelineFramePtr &frame);
+    //the next finished frame, or null. in LATENCY older finished frames are dropped
+    PipelineFramePtr pop();
+    //called from the worker that finished a frame, without the pipeline's lock held
+    void setOutputListener(const std::function<void()> &listener) { outputListener = listener; }
+    
+    //holds new work back and waits for the running stages, so the caller
+    //can use stage state (tracker, simplifier) directly
+    void pause();
+    void resume();
+    //drops every queued frame, call while paused
+    void flush();
+    
+    //one entry per stage plus one for the output queue the app drains
+    vector<StageStats> getStats() const;
+    unsigned long long getSteals() const { return pool.getSteals(); }
+    
+private:
+    struct Stage {
+        Stage() : busy(false), maxDepth(0), processed(0), dropped(0), meanMs(0) {}
+        string                          name;
+        StageFunction                   function;
+        std::deque<PipelineFramePtr>    input;
+        bool                            busy;
+        int                             maxDepth;
+        unsigned long long              processed, dropped;
+        float                           meanMs;
+    };
+    
+    int capacity() const { return policy == PIPELINE_LATENCY ? 1 : 4; }
+    void enqueue(Stage &target, const PipelineFramePtr &frame);
+    void schedule(int index);   //with lock held
+    void run(int index, PipelineFramePtr frame);
+    
+    vector<Stage>               stages;
+    Stage                       output;
+    PipelinePolicy              policy;
+    bool                        paused, running;
+    mutable std::mutex          lock;
+    std::condition_variable     idle;
+    WorkStealingPool            pool;
+    std::function<void()>       outputListener;
+};
+
+#endif
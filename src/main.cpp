@@ -29,6 +29,8 @@
 int main()
 {
     
+    //setup() resizes the window to span the operator display and every
+    //projector output once projectors.xml is loaded
     ofAppGLFWWindow window;
     window.setMultiDisplayFullscreen(true);
     ofSetupOpenGL(&window,2880+1024,768,OF_FULLSCREEN);
@@ -28,6 +28,68 @@
 using namespace ofxCv;
 using namespace cv;
 
+//parameter ids, the strings are the ofxUI widget names so the settings xml files bind directly
+static const ParamId P_EXPOSURE         = paramId("EXPOSURE");
+static const ParamId P_BRIGHTNESS       = paramId("BRIGHTNESS");
+static const ParamId P_GAIN             = paramId("GAIN");
+static const ParamId P_CONTRAST         = paramId("CONTRAST");
+static const ParamId P_SHARPNESS        = paramId("SHARPNESS");
+static const ParamId P_EXPORT_FRAMES    = paramId("EXPORT FRAMES");
+static const ParamId P_MIRROR           = paramId("  MIRROR FULLSCREEN");
+static const ParamId P_LOCK_POINTS      = paramId("  LOCK/UNLOCK POINTS");
+static const ParamId P_SHOW_RAW         = paramId("  SHOW RAW PREVIEW");
+static const ParamId P_AUTO_QUALITY     = paramId("  AUTO QUALITY");
+static const ParamId P_THROUGHPUT       = paramId("  FAVOR THROUGHPUT");
+static const ParamId P_FRAME_PACING     = paramId("  FRAME PACING");
+static const ParamId P_SHOW_TRACKER     = paramId("SHOW/HIDE TRACKING");
+static const ParamId P_INVERT           = paramId("INVERT TRACKING");
+static const ParamId P_THRESHOLD        = paramId("THRESHOLD");
+static const ParamId P_MIN_RADIUS       = paramId("MIN AREA RADIUS");
+static const ParamId P_MAX_RADIUS       = paramId("MAX AREA RADIUS");
+static const ParamId P_PERSISTENCE      = paramId("PERSISTENCE");
+static const ParamId P_MAX_DISTANCE     = paramId("MAX DISTANCE");
+static const ParamId P_VERTEX_BUDGET    = paramId("VERTEX BUDGET");
+static const ParamId P_HASHED_TRACKER   = paramId("HASHED TRACKER");
+static const ParamId P_RUN_SEGMENTER    = paramId("RUN SEGMENTER");
+static const ParamId P_PUPPETS          = paramId("PUPPET RECOGNITION");
+static const ParamId P_PUPPET_DISTANCE  = paramId("PUPPET DISTANCE");
+static const ParamId P_PUBLISH_UDP      = paramId("PUBLISH UDP");
+static const ParamId P_PUBLISH_OSC      = paramId("PUBLISH OSC");
+static const ParamId P_PUBLISH_SHM      = paramId("PUBLISH SHM");
+static const ParamId P_GRAVITY_ON       = paramId("GRAVITY ON");
+static const ParamId P_WALLS_ON         = paramId("WALLS ON");
+static const ParamId P_CIRCLE_MIN       = paramId("CIRCLE MIN");
+static const ParamId P_CIRCLE_MAX       = paramId("CIRCLE MAX");
+static const ParamId P_CIRCLE_FREQ      = paramId("CIRCLE FREQ");
+static const ParamId P_COLLIDER_HULL    = paramId("HULL");
+static const ParamId P_COLLIDER_CHAIN   = paramId("CHAIN");
+static const ParamId P_COLLIDER_DECOMP  = paramId("DECOMPOSED");
+static const ParamId P_FIDELITY         = paramId("COLLIDER FIDELITY");
+static const ParamId P_PROXIES          = paramId("COLLIDER PROXIES");
+static const ParamId P_ACTIVITY_LOD     = paramId("ACTIVITY LOD");
+static const ParamId P_INFLUENCE        = paramId("INFLUENCE RADIUS");
+static const ParamId P_SDF_COUNT        = paramId("SDF PARTICLES");
+static const ParamId P_SDF_SMOKE        = paramId("SDF SMOKE");
+static const ParamId P_ADD_CIRCLE       = paramId("ADD CIRCLE");
+static const ParamId P_ADD_PARTICLES    = paramId("ADD PARTICLES");
+static const ParamId P_CLEAR_SHAPES     = paramId("CLEAR SHAPES");
+
+//PS3 Eye modes selectable from the gui, the first is the startup mode
+struct CameraMode {
+    const char* name;
+    int width, height, fps;
+};
+static const CameraMode cameraModes[] = {
+    { "320x240 @ 120", 320, 240, 120 },
+    { "320x240 @ 187", 320, 240, 187 },
+    { "640x480 @ 60",  640, 480, 60 },
+    { "640x480 @ 30",  640, 480, 30 },
+};
+static const int numCameraModes = sizeof(cameraModes) / sizeof(cameraModes[0]);
+
+//every box2d.update() advances the world by 1 / box2dFps seconds
+static const float box2dFps = 30;
+
 //CALLING THIS TOO FREQUENTLY WILL SLOW FRAMERATE
 static bool shouldRemove(ofPtr<ofxBox2dBaseShape>shape) {
     return !ofRectangle(0, -400, ofGetWidth(), ofGetHeight()+400).inside(shape.get()->getPosition());
@@ -36,14 +98,11 @@ static bool shouldRemove(ofPtr<ofxBox2dBaseShape>shape) {
 void ofApp::setup()
 {
     //-------CAMERA SETUP------------------------------
+    //no vsync: a swap waiting for the display would hold back camera frames faster than it
     ofSetVerticalSync(false);
-	camWidth = 320;
-	camHeight = 240;
-    camFrameRate = 120;
-    xOffset = 1440;
-    displayWidth = xOffset;
-    projectorWidth = 1024;
-    projectorHeight = 768; 
+	camWidth = cameraModes[0].width;
+	camHeight = cameraModes[0].height;
+    camFrameRate = cameraModes[0].fps;
 
     //list devices - seems to only detect PS3 cameras
     std::vector<ofVideoDevice> devices = vidGrabber.listDevices();
@@ -71,11 +130,13 @@ void ofApp::setup()
     homographyReady = false;
     mirrorLeft = false;
     mirrorRight = true;
-    showTracker = true;
+    lockHomography = false;
     
     markProjectorBounds = false;
     drawProjectorBounds = true;
-    applyProjectorHomography = false;
+    markingRegion = -1;
+    drawnBodies = 0;
+    patternVersion = -1;
     
     sX = 0;
     sY = 200;
@@ -86,11 +147,10 @@ void ofApp::setup()
     ofSetWindowPosition(0, 0);
     if(fullScreen) ofSetFullscreen(true);
     
+    //textures are uploaded lazily by StreamedTexture when they are drawn,
+    //so the images only keep their pixels on the CPU.
     videoPix.allocate(camWidth,camHeight,OF_PIXELS_RGBA);
-    videoTexture.allocate(videoPix);
     videoImg.allocate(camWidth, camHeight, OF_IMAGE_COLOR);
-    warpedColor.allocate(camWidth, camHeight, OF_IMAGE_COLOR_ALPHA);
-    projectorWarp.allocate(camWidth, camHeight, OF_IMAGE_COLOR_ALPHA);
     
     // load the previous homography if it's available
     ofFile previous("homography.yml");
@@ -98,6 +158,10 @@ void ofApp::setup()
         FileStorage fs(ofToDataPath("homography.yml"), FileStorage::READ);
         fs["homography"] >> homography;
         homographyReady = true;
+        //older files have no size and were made at 320x240
+        int width = fs["width"].empty() ? 320 : (int)fs["width"];
+        int height = fs["height"].empty() ? 240 : (int)fs["height"];
+        rescaleHomography(width, height);
     }
     
     //load the previous camera homography points
@@ -125,25 +189,22 @@ void ofApp::setup()
         }
         points.popTag();
         
+        rescalePoints(points.getValue("camera:w", 320), points.getValue("camera:h", 240));
     }
     
-    //load the marked corners of the projection.
-    if(projXML.loadFile("projectorPoints.xml")) {
-        projXML.pushTag("Points");
-        int numP = projXML.getNumTags("p");
-        for(int i=0; i<numP; i++) {
-            projXML.pushTag("p",i);
-            ofVec2f tempVec;
-            tempVec.set(projXML.getValue("x",0),projXML.getValue("y",0));
-            projectorPoints.push_back(tempVec);
-            projXML.popTag();
-        }
-        projXML.popTag();
+    //load the projector outputs and their marked corners
+    if(!layout.load()) ofLogNotice("projectors") << "no projectors.xml, using a single projector";
+    ofSetWindowShape(layout.getWindowWidth(), layout.getWindowHeight());
+    for(int r=0; r<layout.regions.size(); r++) {
+        layout.regions[r].calibrate(camWidth, camHeight);
     }
     
-    if(projectorPoints.size() >= 4) {
-        writeProjectorPoints();
-    }
+    //puppet templates, taught with 'k' or edited by hand
+    puppetPath = "puppets.txt";
+    if(!puppets.load(puppetPath)) ofLogNotice("puppets") << "no " << puppetPath << ", no puppets to recognise yet";
+    puppetTemplates = puppets.size();
+    puppetLookups = 0;
+    puppetMs = 0;
     
     
     //------Box2D Setup ----------
@@ -152,15 +213,71 @@ void ofApp::setup()
     ofSetLogLevel(OF_LOG_NOTICE);
     box2d.init();
     box2d.setGravity(20.0, 0.0);
-    box2d.createGround();
-    box2d.setFPS(30.0);
+    createGround();
+    box2d.setFPS(box2dFps);
     addWalls();
+    silhouettes.setup(box2d.getWorld());
+    silhouetteSeconds = 0;
+    silhouettesStale = true;
+    maxParticles = 2000;
+    gravityOn = true;
+    wallsOn = true;
+    circleMin = 2;
+    circleMax = 20;
+    circleFreq = 20;
+    
+    //warm restart: put back whatever was in the world when the app last ran
+    sceneRestored = false;
+    snapshotInterval = 5.0;
+    lastSnapshotTime = 0;
+    unsigned long long restoreStart = ofGetElapsedTimeMicros();
+    if(restoredScene.load("scene.snapshot")) {
+        restoreSceneBodies(restoredScene);
+        sceneRestored = true;
+        ofLogNotice("SceneSnapshot") << "restored " << restoredScene.bodies.size() << " bodies in "
+            << (ofGetElapsedTimeMicros() - restoreStart) / 1000.0 << " ms";
+    }
+    snapshotWriter.setup("scene.snapshot");
+    replaySteps = 2000;
    
     //-------UI setup------------
     ofEnableSmoothing();
     ofSetCircleResolution(60);
     debugPos = ofPoint(10,camHeight+35);
+    statsText.interval = 0.25;
     frameCount = 0;
+    blurSize = 5;
+    governor.setup(camFrameRate);
+    workStart = ofGetElapsedTimef();
+    workSeconds = 0;
+    sdfTime = ofGetElapsedTimef();
+    
+    setupParams();
+    
+    //where tracking results are published, see TrackingPublisher
+    publishHost = "127.0.0.1";
+    publishPort = 12000;
+    publishShmName = "shadowPuppetry.tracking";
+    ofxXmlSettings publishXML;
+    if(publishXML.loadFile("Publish_Settings.xml")) {
+        publishHost = publishXML.getValue("host", publishHost);
+        publishPort = publishXML.getValue("port", publishPort);
+        publishShmName = publishXML.getValue("shm", publishShmName);
+    }
+    frameCaptureMicros = 0;
+    cameraFrameNumber = 0;
+    loopbackActive = false;
+    
+    //warp and tracking run on worker threads, a frame behind each other
+    vertexBudget = 512;
+    contourVertices = 0;
+    visionScale = 1;
+    pipeline.addStage("warp", [this](PipelineFrame &frame) { warpFrame(frame); });
+    pipeline.addStage("track", [this](PipelineFrame &frame) { trackFrame(frame); });
+    pipeline.start(MAX(2, MIN(4, (int)std::thread::hardware_concurrency() - 1)));
+    pipeline.setOutputListener([this] { pacer.notify(); });
+    sdfParticles.setup(MAX(1, (int)std::thread::hardware_concurrency() - 1));
+    sdfCount = 0;
     
     //TODO: - pull the develop branch of ofxUI to fix this issue
     //https://github.com/rezaali/ofxUI/issues/218  discusses the initialization issue.
@@ -172,6 +289,10 @@ void ofApp::setup()
     gui0->addMinimalSlider("GAIN", 0.0, 63.0, 50.0);
     gui0->addMinimalSlider("CONTRAST", 0.0, 255.0, 200.0);
     gui0->addMinimalSlider("SHARPNESS", 0.0, 255.0, 0.0);
+    vector<string> modes;
+    for(int i = 0; i < numCameraModes; i++) modes.push_back(cameraModes[i].name);
+    gui0->addRadio("CAMERA MODE", modes, OFX_UI_ORIENTATION_VERTICAL)->activateToggle(cameraModes[0].name);
+    gui0->addToggle("EXPORT FRAMES", false);
     gui0->addLabelButton("SAVE SETTINGS", false);
     gui0->autoSizeToFitWidgets();
     ofAddListener(gui0->newGUIEvent,this,&ofApp::guiEvent);
@@ -182,6 +303,10 @@ void ofApp::setup()
     gui1->addToggle("  MIRROR FULLSCREEN", true);
     gui1->addToggle("  TOGGLE FULLSCREEN", false);
     gui1->addToggle("  LOCK/UNLOCK POINTS", false); 
+    gui1->addToggle("  SHOW RAW PREVIEW", true);
+    gui1->addToggle("  AUTO QUALITY", false);
+    gui1->addToggle("  FAVOR THROUGHPUT", false);
+    gui1->addToggle("  FRAME PACING", true);
     gui1->addLabelButton("CLEAR HOMOGRAPHY", false);
     gui1->addLabelButton("SAVE HOMOGRAPHY", false);
     gui1->addLabelButton("REFRESH GUIS", false);
@@ -197,6 +322,14 @@ void ofApp::setup()
     gui2->addMinimalSlider("MAX AREA RADIUS", 0.0, 200.0, 100.0);
     gui2->addMinimalSlider("PERSISTENCE", 0.0, 60.0, 15.0);
     gui2->addMinimalSlider("MAX DISTANCE", 0.0, 250.0, 32.0);
+    gui2->addMinimalSlider("VERTEX BUDGET", 32.0, 2048.0, 512.0);
+    gui2->addToggle("HASHED TRACKER", false);
+    gui2->addToggle("RUN SEGMENTER", false);
+    gui2->addToggle("PUPPET RECOGNITION", false);
+    gui2->addMinimalSlider("PUPPET DISTANCE", 0.1, 4.0, 1.0);
+    gui2->addToggle("PUBLISH UDP", false);
+    gui2->addToggle("PUBLISH OSC", false);
+    gui2->addToggle("PUBLISH SHM", false);
     gui2->addLabelButton("SAVE TRACKING", false);
     gui2->autoSizeToFitWidgets();
     ofAddListener(gui2->newGUIEvent,this,&ofApp::guiEvent);  //load settings triggers event updates
@@ -208,6 +341,17 @@ void ofApp::setup()
     gui3->addMinimalSlider("CIRCLE MIN", 0.0, 200.0, 2.0);
     gui3->addMinimalSlider("CIRCLE MAX", 0.0, 200.0, 20.0);
     gui3->addMinimalSlider("CIRCLE FREQ", 0.0, 50.0, 20.0);
+    vector<string> colliders;
+    colliders.push_back("HULL");
+    colliders.push_back("CHAIN");
+    colliders.push_back("DECOMPOSED");
+    gui3->addRadio("COLLIDER", colliders, OFX_UI_ORIENTATION_HORIZONTAL)->activateToggle("HULL");
+    gui3->addMinimalSlider("COLLIDER FIDELITY", 8.0, 128.0, 48.0);
+    gui3->addMinimalSlider("COLLIDER PROXIES", 16.0, 512.0, 256.0);
+    gui3->addToggle("ACTIVITY LOD", false);
+    gui3->addMinimalSlider("INFLUENCE RADIUS", 20.0, 600.0, 150.0);
+    gui3->addMinimalSlider("SDF PARTICLES", 0.0, 200000.0, 0.0);
+    gui3->addToggle("SDF SMOKE", false);
     gui3->addLabelButton("ADD CIRCLE", false);
     gui3->addLabelButton("ADD PARTICLES", false);
     gui3->addLabelButton("CLEAR SHAPES", false);
@@ -216,7 +360,7 @@ void ofApp::setup()
     ofAddListener(gui3->newGUIEvent,this,&ofApp::guiEvent);  //load settings triggers event updates
 
     //refreshGUIs();
-    //ofShowCursor();
+    ofShowCursor();
 
     
 }
@@ -225,20 +369,22 @@ void ofApp::addWalls() {
     //add walls
     float wallSize = 30;
     float buffer = 5;
+    //the walls enclose all projector outputs together
+    ofRectangle outputs = layout.getOutputBounds();
     //top
     //TODO: fix walls - why are the walls
     walls.push_back(shared_ptr<ofxBox2dRect>(new ofxBox2dRect));
     walls.back().get()->setPhysics(0.0, 0.0, 0.0);
-    walls.back().get()->setup(box2d.getWorld(), displayWidth-wallSize, -1*wallSize+buffer, projectorWidth + wallSize*2, wallSize);
+    walls.back().get()->setup(box2d.getWorld(), outputs.x-wallSize, -1*wallSize+buffer, outputs.width + wallSize*2, wallSize);
     
     //right
     walls.push_back(shared_ptr<ofxBox2dRect>(new ofxBox2dRect));
     walls.back().get()->setPhysics(0.0, 0.0, 0.0);
-    walls.back().get()->setup(box2d.getWorld(), displayWidth+projectorWidth*2, projectorHeight/2, wallSize, projectorHeight + wallSize*2);
+    walls.back().get()->setup(box2d.getWorld(), outputs.getRight()+wallSize-buffer, outputs.height/2, wallSize, outputs.height + wallSize*2);
     //left
     walls.push_back(shared_ptr<ofxBox2dRect>(new ofxBox2dRect));
     walls.back().get()->setPhysics(0.0, 0.0, 0.0);
-    walls.back().get()->setup(box2d.getWorld(), displayWidth-wallSize+buffer, projectorHeight/2, wallSize, projectorHeight + wallSize*2);
+    walls.back().get()->setup(box2d.getWorld(), outputs.x-wallSize+buffer, outputs.height/2, wallSize, outputs.height + wallSize*2);
 
 }
 
@@ -253,18 +399,33 @@ void ofApp::updateGUIPostions() {
 
 void ofApp::update()
 {
-
-    
-    //-----------------PS3--------------------------
-    updateGUIPostions();
-    vidGrabber.update();
-	if (vidGrabber.isFrameNew())
-    {
-		videoTexture.loadData(vidGrabber.getPixels());
-        videoPix.setFromPixels(vidGrabber.getPixels(), camWidth, camHeight, OF_PIXELS_RGBA);
-	}
+    //-----------------quality--------------------------
+    //once per present, on the work of every wake and the draw since the last one.
+    //sleeping in the pacer or frame limiter is not load
+    bool wasAuto = governor.isEnabled();
+    governor.setEnabled(params.get(P_AUTO_QUALITY).getBool());
+    if(wasAuto && !governor.isEnabled()) applyGovernedQuality();
+    if(governor.update(workSeconds)) applyGovernedQuality();
+    workSeconds = 0;
     
+    //paced, the loop keeps waking and working in here until there is something to
+    //present, so draw() and the buffer swap only run for frames that show a change
+    do {
+        pacer.wait();
+        if(pacer.enabled) ofGetMainLoop()->pollEvents();
+        float start = ofGetElapsedTimef();
+        updateWake();
+        workSeconds += ofGetElapsedTimef() - start;
+    } while(pacer.enabled && !pacer.shouldPresent());
+    workStart = ofGetElapsedTimef();
+}
+
+void ofApp::updateWake()
+{
     //-----------------video homography---------------------
+    updateGUIPostions();
+    applyCameraParams();
+    applyTrackingParams();
    // if(fullScreen) lockHomography = true;
     
     if(!lockHomography) {
@@ -281,39 +442,87 @@ void ofApp::update()
             homographyReady = true;
             
             if(saveMatrix) {
-                FileStorage fs(ofToDataPath("homography.yml"), FileStorage::WRITE);
-                fs << "homography" << homography;
+                saveHomography();
                 saveMatrix = false;
             }
         }
     }
     
-    if(homographyReady) {
-        // this is how you warp one ofImage into another ofImage given the homography matrix
-        // CV INTER NN is 113 fps, CV_INTER_LINEAR is 93 fps
-        //warpPerspective(right, warpedColor, homography, CV_INTER_LINEAR);
-        warpPerspective(videoPix, warpedColor, homography, CV_INTER_LINEAR);
-        warpedColor.update();
+    //-----------------PS3--------------------------
+    vidGrabber.update();
+	if (vidGrabber.isFrameNew())
+    {
+        videoPix.setFromPixels(vidGrabber.getPixels(), camWidth, camHeight, OF_PIXELS_RGBA);
+        videoTexture.markStale(videoPix);
+        frameCaptureMicros = ofGetSystemTimeMicros();
+        cameraFrameNumber++;
+        //the raw camera goes out as soon as it arrives, warped and mask follow from the track stage
+        frameExporter.publish(EXPORT_CAMERA, videoPix, cameraFrameNumber, frameCaptureMicros);
+        pacer.cameraFrame();
+        if(autoCalibration.addCameraFrame(videoPix)) finishAutoCalibration();
+        if(autoCalibration.getPatternVersion() != patternVersion) pacer.markChanged();
         
-        if(applyProjectorHomography) {
-            warpPerspective(warpedColor, projectorWarp, projectorHomography, CV_INTER_LINEAR);
-            projectorWarp.update();
+        //the frame carries everything the stages need from here
+        PipelineFramePtr frame(new PipelineFrame);
+        frame->sequence = cameraFrameNumber;
+        frame->captureMicros = frameCaptureMicros;
+        frame->camera = videoPix;
+        if(homographyReady) frame->homography = homography;
+        frame->mirror = mirrorLeft;
+        frame->blurSize = blurSize;
+        frame->vertexBudget = vertexBudget;
+        frame->pixelScale = camWidth / 320.0f;
+        frame->teachPuppet = pendingPuppet;
+        pendingPuppet.clear();
+        frame->wantDistance = sdfParticles.getCount() > 0;
+        //every outline when they are drawn or sent out, otherwise only those that become bodies
+        frame->wantOutlines = params.get(P_SHOW_TRACKER).getBool() || traceWriter.isOpen() || frame->wantDistance
+            || params.get(P_PUBLISH_UDP).getBool() || params.get(P_PUBLISH_OSC).getBool() || params.get(P_PUBLISH_SHM).getBool()
+            || !layout.isCalibrated();
+        for(int r = 0; r < layout.regions.size(); r++) {
+            if(!layout.regions[r].calibrated) continue;
+            const ofRectangle &area = layout.regions[r].cameraArea;
+            frame->outlineAreas.push_back(ofRectangle(area.x * camWidth, area.y * camHeight, area.width * camWidth, area.height * camHeight));
         }
-        
-       // if(fullScreen) {
-            if(mirrorLeft)warpedColor.mirror(false, true);
-       // }
-    }
+        pipeline.push(frame);
+	}
     
     //-----------------tracking--------------------------
     
-    blur(warpedColor,5);
-    contourFinder.findContours(warpedColor);
+    PipelineFramePtr done = pipeline.pop();
+    if(done) {
+        //the texture uploads lazily from these pixels and holds the frame until then.
+        //a frame without them (no homography yet) must not leave the old image up
+        shownFrame = done;
+        if(shownFrame->warped.isAllocated()) warpedTexture.markStale(shownFrame->warped, shownFrame);
+        else warpedTexture.clear();
+        tracked = shownFrame->tracked;
+        contourVertices = shownFrame->vertexCount;
+        puppetTemplates = shownFrame->puppetTemplates;
+        puppetLookups = shownFrame->puppetLookups;
+        puppetMs = shownFrame->puppetMs;
+        triggerPuppets();
+        traceWriter.writeFrame(tracked);
+        silhouettesStale = true;
+        pacer.markChanged();
+    }
+    updateSdfParticles(done);
+    if(loopbackActive) checkLoopback();
     
     //having some strange NaN behaviors while initializing
     frameCount++;
     if(frameCount == 30){
         refreshGUIs();
+        //the saved gui settings would otherwise override the restored scene
+        if(sceneRestored) restoreSceneParams(restoredScene);
+    }
+    
+    //-----------------snapshot--------------------------
+    if(ofGetElapsedTimef() - lastSnapshotTime > snapshotInterval) {
+        SceneSnapshot snapshot;
+        captureScene(snapshot);
+        snapshotWriter.submit(snapshot);
+        lastSnapshotTime = ofGetElapsedTimef();
     }
     
     //-----------------Box2D --------------------
@@ -323,47 +532,427 @@ void ofApp::update()
         if((int)ofRandom(0, circleFreq) == 0) {
             shared_ptr<ofxBox2dCircle> circle = shared_ptr<ofxBox2dCircle>(new ofxBox2dCircle);
             circle.get()->setPhysics(0.3, 0.5, 0.1);
-            circle.get()->setup(box2d.getWorld(), xOffset + ((ofGetWidth()-xOffset)/2) + ofRandom(-20, 20), -20, ofRandom(circleMin, circleMax));
+            circle.get()->setup(box2d.getWorld(), layout.getOutputBounds().getCenter().x + ofRandom(-20, 20), -20, ofRandom(circleMin, circleMax));
             circles.push_back(circle);
         }
      */
         
-        // remove shapes offscreen
-        ofRemove(circles, shouldRemove);
-        ofRemove(customParticles, shouldRemove);
+        applyPhysicsParams();
     
-        polyShapes.clear();
-        //RectTracker& tracker = contourFinder.getTracker();   //use to get labels
-        for(int i = 0; i < contourFinder.size(); i++) {
-            ofPolyline temp = contourFinder.getPolyline(i);
-            createBox2DShape(temp);
-            updateBox2DForces(contourFinder.getCentroid(i));
+        //physics runs on the pacer's clock, not once per loop
+        int steps = pacer.physicsSteps();
+        if(steps > 0) {
+            // remove shapes offscreen
+            ofRemove(circles, shouldRemove);
+            ofRemove(customParticles, shouldRemove);
+        
+            //the silhouettes only move with a tracked frame, their velocity covers
+            //every step simulated since the last one
+            if(silhouettesStale) {
+                polyShapes.clear();
+                createSilhouettes(silhouetteSeconds);
+                silhouetteSeconds = 0;
+                silhouettesStale = false;
+            }
+            //box2d clears forces after every step
+            for(int i = 0; i < steps; i++) {
+                updateBox2DForces();
+                box2d.update();
+                silhouetteSeconds += 1.0f / box2dFps;
+            }
         }
+        pacer.physicsActive = activity.getCount(ACTIVITY_ACTIVE) > 0 || sdfParticles.getCount() > 0;
+        if(steps > 0 && pacer.physicsActive) pacer.markChanged();
     
-        box2d.update();
-    
 }
 
-void ofApp::updateBox2DForces(cv::Point2f centroid) {
+//pipeline stage: camera frame -> warped frame
+void ofApp::warpFrame(PipelineFrame &frame) {
+    if(frame.homography.empty()) return;
+    // this is how you warp one ofImage into another ofImage given the homography matrix
+    // CV INTER NN is 113 fps, CV_INTER_LINEAR is 93 fps
+    warpPerspective(frame.camera, frame.warped, frame.homography, CV_INTER_LINEAR);
+    if(frame.mirror) frame.warped.mirror(false, true);
+}
+
+//pipeline stage: contours, export and publishing. the only place that touches
+//the contour finder, simplifier, exporter and publisher while the pipeline runs
+void ofApp::trackFrame(PipelineFrame &frame) {
+    applyVisionParams(frame.pixelScale);
+    frame.tracked.sequence = frame.sequence;
+    frame.tracked.captureMicros = frame.captureMicros;
+    if(frame.warped.isAllocated()) {
+        blur(frame.warped, frame.blurSize);
+        //the hashed tracker labels the blobs itself, the RectTracker isn't run then
+        bool hashed = params.get(P_HASHED_TRACKER).getBool();
+        if(params.get(P_RUN_SEGMENTER).getBool()) {
+            updateTrackingMask(frame);
+            segmenter.segment(frame.mask);
+            collectRuns(frame, !hashed);
+        } else if(hashed) {
+            updateTrackingMask(frame);
+            findBlobs(frame);
+        } else {
+            contourFinder.findContours(frame.warped);
+            collectBlobs(frame.tracked);
+        }
+        if(hashed) blobTracker.track(frame.tracked.blobs);
+        if(!frame.teachPuppet.empty()) teachPuppet(frame);
+        if(params.get(P_PUPPETS).getBool()) {
+            //the run segmenter only traces the outlines that need a new lookup
+            std::function<void(int, ofPolyline&)> trace;
+            if(params.get(P_RUN_SEGMENTER).getBool()) trace = [this](int i, ofPolyline &outline) { segmenter.traceOutline(i, outline); };
+            puppets.recognize(frame.tracked.blobs, trace);
+            frame.puppetLookups = puppets.getLookupCount();
+            frame.puppetMs = puppets.getLookupMs();
+        }
+        frame.puppetTemplates = puppets.size();
+    }
+    if(frame.wantDistance && frame.warped.isAllocated()) {
+        if(!frame.mask.isAllocated()) updateTrackingMask(frame);
+        updateDistanceField(frame);
+    }
+    if(frameExporter.isEnabled() && frame.warped.isAllocated()) {
+        if(!frame.mask.isAllocated()) updateTrackingMask(frame);
+        frameExporter.publish(EXPORT_WARPED, frame.warped, frame.sequence, frame.captureMicros);
+        frameExporter.publish(EXPORT_MASK, frame.mask, frame.sequence, frame.captureMicros);
+    }
+    simplifier.vertexBudget = frame.vertexBudget;
+    simplifier.pixelScale = frame.pixelScale;
+    simplifier.simplify(frame.tracked.blobs);
+    frame.vertexCount = simplifier.getVertexCount();
+    publisher.publish(frame.tracked, frame.camera.getWidth(), frame.camera.getHeight());
+}
+
+//the binary image the contour finder sees: gray, thresholded and optionally inverted
+void ofApp::updateTrackingMask(PipelineFrame &frame) {
+    Mat gray;
+    cvtColor(toCv(frame.warped), gray, CV_RGBA2GRAY);
+    frame.mask.allocate(gray.cols, gray.rows, OF_PIXELS_GRAY);
+    Mat mask = toCv(frame.mask);
+    int type = params.get(P_INVERT).getBool() ? THRESH_BINARY_INV : THRESH_BINARY;
+    cv::threshold(gray, mask, params.get(P_THRESHOLD).get(), 255, type);
+}
+
+//signed distance to the shadows: positive outside, negative inside
+void ofApp::updateDistanceField(PipelineFrame &frame) {
+    Mat mask = toCv(frame.mask);
+    Mat outside, inside;
+    distanceTransform(~mask, outside, CV_DIST_L2, 3);
+    distanceTransform(mask, inside, CV_DIST_L2, 3);
+    frame.distance = outside - inside;
+}
+
+//feeds this frame's shadows to the sdf particles and steps them
+void ofApp::updateSdfParticles(const PipelineFramePtr &frame) {
+    //several wakes can run per oF frame, so the step is the time since the last one.
+    //capped, a long stall (camera switch, replay) doesn't throw everything away
+    float now = ofGetElapsedTimef();
+    float seconds = MIN(now - sdfTime, 0.1f);
+    sdfTime = now;
+    sdfParticles.setCount(sdfCount);
+    if(sdfParticles.getCount() == 0) return;
+    sdfParticles.setBounds(camWidth, camHeight);
+    if(frame) {
+        sdfParticles.setField(frame->distance);
+        vector<ofPoint> outlines;
+        for(int i = 0; i < tracked.blobs.size(); i++) {
+            const vector<ofPoint> &verts = tracked.blobs[i].simplified.getVertices();
+            outlines.insert(outlines.end(), verts.begin(), verts.end());
+        }
+        sdfParticles.setEmitters(outlines);
+    }
+    //pull the same way box2d does on the projection
+    sdfParticles.gravity = gravityOn ? windowToCamera(ofVec2f(1, 0)) * 200 : ofVec2f(0, 0);
+    sdfParticles.update(seconds);
+}
+
+//a direction on the projection as a unit direction in camera pixels, through
+//the local linear part of the first calibrated output's homography
+ofVec2f ofApp::windowToCamera(const ofVec2f &dir) {
+    ofPoint c(camWidth/2, camHeight/2);
+    int r = layout.regionForCamera(c, camWidth, camHeight);
+    if(r < 0) return dir;
+    const ProjectorRegion &region = layout.regions[r];
+    ofPoint o = region.cameraToWindow(c, camWidth, camHeight);
+    ofPoint ex = region.cameraToWindow(c + ofPoint(1, 0), camWidth, camHeight) - o;
+    ofPoint ey = region.cameraToWindow(c + ofPoint(0, 1), camWidth, camHeight) - o;
+    float det = ex.x * ey.y - ey.x * ex.y;
+    if(fabs(det) < 1e-6) return dir;
+    ofVec2f v((dir.x * ey.y - ey.x * dir.y) / det, (ex.x * dir.y - dir.x * ex.y) / det);
+    return v.getNormalized();
+}
+
+//copies the contour finder results into the frame's TrackedBlobs
+void ofApp::collectBlobs(TrackingFrame &frame) {
+    RectTracker& tracker = contourFinder.getTracker();
+    frame.blobs.resize(contourFinder.size());
+    for(int i = 0; i < contourFinder.size(); i++) {
+        TrackedBlob &blob = frame.blobs[i];
+        blob.label = contourFinder.getLabel(i);
+        blob.age = tracker.getAge(blob.label);
+        blob.contour = contourFinder.getPolyline(i);
+        blob.centroid = toOf(contourFinder.getCentroid(i));
+        blob.center = toOf(contourFinder.getCenter(i));
+        blob.velocity = toOf(contourFinder.getVelocity(i));
+        blob.bounds = toOf(contourFinder.getBoundingRect(i));
+        blob.area = contourFinder.getContourArea(i);
+        blob.perimeter = blob.contour.getPerimeter();
+    }
+}
+
+//the contour finder's outlines without its RectTracker, for the hashed tracker to label.
+//the same area limits, from the thresholded frame.mask
+void ofApp::findBlobs(PipelineFrame &frame) {
+    vector<vector<cv::Point> > contours;
+    cv::findContours(toCv(frame.mask), contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+    float minRadius = params.get(P_MIN_RADIUS).get() * frame.pixelScale;
+    float maxRadius = params.get(P_MAX_RADIUS).get() * frame.pixelScale;
+    frame.tracked.blobs.clear();
+    for(int i = 0; i < contours.size(); i++) {
+        double area = contourArea(contours[i]);
+        if(area < PI * minRadius * minRadius || area > PI * maxRadius * maxRadius) continue;
+        frame.tracked.blobs.push_back(TrackedBlob());
+        TrackedBlob &blob = frame.tracked.blobs.back();
+        blob.label = -1;
+        blob.age = 0;
+        blob.contour = toOf(contours[i]);
+        blob.contour.setClosed(true);
+        blob.bounds = toOf(boundingRect(contours[i]));
+        blob.center = blob.bounds.getCenter();
+        Moments m = moments(contours[i]);
+        blob.centroid = m.m00 > 0 ? ofVec2f(m.m10 / m.m00, m.m01 / m.m00) : blob.center;
+        blob.velocity.set(0, 0);
+        blob.area = area;
+        blob.perimeter = blob.contour.getPerimeter();
+    }
+}
+
+//copies the run segmenter results into the frame's TrackedBlobs. labels come from
+//the contour finder's tracker, so they carry over when switching between the two,
+//unless track is off for another tracker to label them.
+//outlines are traced only where frame.wantOutlines or frame.outlineAreas ask for them
+void ofApp::collectRuns(PipelineFrame &frame, bool track) {
+    vector<cv::Rect> rects(segmenter.size());
+    for(int i = 0; i < segmenter.size(); i++) rects[i] = toCv(segmenter.getComponent(i).bounds);
+    RectTracker& tracker = contourFinder.getTracker();
+    static const vector<unsigned int> none;
+    const vector<unsigned int> &labels = track ? tracker.track(rects) : none;
+    frame.tracked.blobs.resize(segmenter.size());
+    for(int i = 0; i < segmenter.size(); i++) {
+        const RunComponent &component = segmenter.getComponent(i);
+        TrackedBlob &blob = frame.tracked.blobs[i];
+        blob.label = track ? labels[i] : -1;
+        blob.age = track ? tracker.getAge(blob.label) : 0;
+        blob.centroid = component.centroid;
+        blob.center = component.bounds.getCenter();
+        blob.velocity = track ? toOf(tracker.getVelocity(i)) : ofVec2f(0, 0);
+        blob.bounds = component.bounds;
+        blob.area = component.area;
+        blob.perimeter = component.perimeter;
+        bool wanted = frame.wantOutlines;
+        for(int a = 0; a < frame.outlineAreas.size() && !wanted; a++) wanted = frame.outlineAreas[a].inside(blob.centroid);
+        if(wanted) segmenter.traceOutline(i, blob.contour);
+        else blob.contour.clear();
+    }
+}
+
+//track stage: the largest blob becomes another template of the puppet being taught
+void ofApp::teachPuppet(PipelineFrame &frame) {
+    int largest = -1;
+    for(int i = 0; i < frame.tracked.blobs.size(); i++) {
+        if(largest < 0 || frame.tracked.blobs[i].area > frame.tracked.blobs[largest].area) largest = i;
+    }
+    if(largest < 0) {
+        ofLogWarning("puppets") << "no shadow to learn " << frame.teachPuppet << " from";
+        return;
+    }
+    ofPolyline outline = frame.tracked.blobs[largest].contour;
+    if(outline.size() < 3 && params.get(P_RUN_SEGMENTER).getBool()) segmenter.traceOutline(largest, outline);
+    if(!puppets.addTemplate(frame.teachPuppet, outline)) {
+        ofLogWarning("puppets") << "the shadow is too small to learn " << frame.teachPuppet << " from";
+        return;
+    }
+    puppets.save(puppetPath);
+    ofLogNotice("puppets") << "learned " << frame.teachPuppet << ", " << puppets.size() << " templates";
+}
+
+//a label showing a different puppet than last frame triggers that puppet's content
+void ofApp::triggerPuppets() {
+    map<int, string> shown;
+    for(int i = 0; i < tracked.blobs.size(); i++) {
+        if(!tracked.blobs[i].puppet.empty()) shown[tracked.blobs[i].label] = tracked.blobs[i].puppet;
+    }
+    for(map<int, string>::iterator it = shown.begin(); it != shown.end(); ++it) {
+        map<int, string>::iterator before = shownPuppets.find(it->first);
+        if(before == shownPuppets.end() || before->second != it->second) {
+            ofLogNotice("puppets") << it->second << " appeared as blob " << it->first;
+        }
+    }
+    for(map<int, string>::iterator it = shownPuppets.begin(); it != shownPuppets.end(); ++it) {
+        map<int, string>::iterator after = shown.find(it->first);
+        if(after == shown.end() || after->second != it->second) {
+            ofLogNotice("puppets") << it->second << " left blob " << it->first;
+        }
+    }
+    shownPuppets.swap(shown);
+}
+
+//attracts the bodies near a contour towards every contour, the far ones are
+//left alone so the activity lod can put them to sleep
+void ofApp::updateBox2DForces() {
     float strength = 8.0f;
     float damping  = 0.7f;
     float minDis   = 100;
-    float ratioW = projectorWidth/camWidth;
-    float ratioH = projectorHeight/camHeight;
+    
+    //one attraction point per contour, in the output that shows it
+    vector<ofPoint> targets, bounds(4);
+    activity.begin();
+    for(int i = 0; i < tracked.blobs.size() && drawProjectorBounds; i++) {
+        const TrackedBlob &blob = tracked.blobs[i];
+        int r = layout.regionForCamera(blob.centroid, camWidth, camHeight);
+        if(r < 0) continue;
+        const ProjectorRegion &region = layout.regions[r];
+        targets.push_back(region.cameraToWindow(blob.centroid, camWidth, camHeight));
+        //the zone reaches the farthest corner of the blob's bounds as the projector shows them
+        bounds[0] = blob.bounds.getTopLeft();
+        bounds[1] = blob.bounds.getTopRight();
+        bounds[2] = blob.bounds.getBottomRight();
+        bounds[3] = blob.bounds.getBottomLeft();
+        region.cameraToWindow(bounds, camWidth, camHeight);
+        float radius = 0;
+        for(int k=0; k<bounds.size(); k++) radius = MAX(radius, targets.back().distance(bounds[k]));
+        activity.addZone(targets.back(), radius);
+    }
+    
     for(int i=0; i<circles.size(); i++) {
-        if(drawProjectorBounds) {
-        circles[i].get()->addAttractionPoint(centroid.x*ratioW + projectorPoints[0].x, centroid.y*ratioH + projectorPoints[0].y, strength);
+        if(!activity.update(circles[i].get()->body) || targets.empty()) continue;
+        for(int t=0; t<targets.size(); t++) circles[i].get()->addAttractionPoint(targets[t].x, targets[t].y, strength);
         circles[i].get()->setDamping(damping, damping);
-        }
     }
     for(int i=0; i<customParticles.size(); i++) {
-        if(drawProjectorBounds) {
-        customParticles[i].get()->addAttractionPoint(centroid.x*ratioW + projectorPoints[0].x, centroid.y*ratioH + projectorPoints[0].y, strength);
+        if(!activity.update(customParticles[i].get()->body) || targets.empty()) continue;
+        for(int t=0; t<targets.size(); t++) customParticles[i].get()->addAttractionPoint(targets[t].x, targets[t].y, strength);
         customParticles[i].get()->setDamping(damping, damping);
+    }
+    activity.end();
+}
+
+
+//pushes a governor quality level into the knobs that used to be hand tuned
+void ofApp::applyQuality(const QualityLevel &level) {
+    blurSize = level.blurSize;
+    ofSetCircleResolution(level.circleResolution);
+    vertexBudget = level.vertexBudget;
+    silhouettes.fidelity = level.colliderFidelity;
+    box2d.setIterations(level.velocityIterations, level.positionIterations);
+    maxParticles = level.maxParticles;
+    trimParticles();
+}
+
+//the governor's current level, except that with auto quality off the vertex
+//budget and collider fidelity sliders are the user's and win
+void ofApp::applyGovernedQuality() {
+    applyQuality(governor.getLevel());
+    if(governor.isEnabled()) return;
+    vertexBudget = params.get(P_VERTEX_BUDGET).get();
+    silhouettes.fidelity = params.get(P_FIDELITY).get();
+}
+
+//drops the oldest bodies when there are more than maxParticles
+void ofApp::trimParticles() {
+    int over = circles.size() + customParticles.size() - maxParticles;
+    if(over <= 0) return;
+    int fromParticles = MIN(over, (int)customParticles.size());
+    customParticles.erase(customParticles.begin(), customParticles.begin() + fromParticles);
+    over -= fromParticles;
+    if(over > 0) circles.erase(circles.begin(), circles.begin() + MIN(over, (int)circles.size()));
+}
+
+//copies the dynamic bodies and physics settings out of the world, must run on the update thread
+void ofApp::captureScene(SceneSnapshot &snapshot) {
+    snapshot.savedMicros = ofGetSystemTimeMicros();
+    snapshot.params.gravityOn = gravityOn;
+    snapshot.params.wallsOn = wallsOn;
+    snapshot.params.gravityX = box2d.getGravity().x;
+    snapshot.params.gravityY = box2d.getGravity().y;
+    snapshot.params.circleMin = circleMin;
+    snapshot.params.circleMax = circleMax;
+    snapshot.params.circleFreq = circleFreq;
+    snapshot.params.maxParticles = maxParticles;
+    
+    snapshot.bodies.clear();
+    snapshot.bodies.reserve(circles.size() + customParticles.size());
+    for(int i=0; i<circles.size() + customParticles.size(); i++) {
+        bool isCircle = i < circles.size();
+        ofxBox2dCircle *shape = isCircle ? circles[i].get() : customParticles[i - circles.size()].get();
+        if(shape->body == NULL) continue;
+        SnapshotBody body;
+        body.kind = isCircle ? SNAPSHOT_CIRCLE : SNAPSHOT_PARTICLE;
+        ofColor color = isCircle ? ofColor(0xc0, 0xdd, 0x3b) : customParticles[i - circles.size()]->color;
+        body.r = color.r;
+        body.g = color.g;
+        body.b = color.b;
+        ofVec2f pos = shape->getPosition();
+        ofVec2f vel = shape->getVelocity();
+        body.x = pos.x;
+        body.y = pos.y;
+        body.vx = vel.x;
+        body.vy = vel.y;
+        body.angle = shape->body->GetAngle();
+        body.angularVelocity = shape->body->GetAngularVelocity();
+        body.radius = shape->getRadius();
+        body.density = shape->density;
+        body.bounce = shape->bounce;
+        body.friction = shape->friction;
+        snapshot.bodies.push_back(body);
+    }
+}
+
+void ofApp::restoreSceneBodies(const SceneSnapshot &snapshot) {
+    for(int i=0; i<snapshot.bodies.size(); i++) {
+        const SnapshotBody &body = snapshot.bodies[i];
+        ofxBox2dCircle *shape;
+        if(body.kind == SNAPSHOT_PARTICLE) {
+            customParticles.push_back(shared_ptr<CustomParticle>(new CustomParticle));
+            customParticles.back()->color.set(body.r, body.g, body.b);
+            shape = customParticles.back().get();
+        } else {
+            circles.push_back(shared_ptr<ofxBox2dCircle>(new ofxBox2dCircle));
+            shape = circles.back().get();
         }
+        shape->setPhysics(body.density, body.bounce, body.friction);
+        shape->setup(box2d.getWorld(), body.x, body.y, body.radius);
+        shape->setVelocity(body.vx, body.vy);
+        shape->body->SetTransform(shape->body->GetPosition(), body.angle);
+        shape->body->SetAngularVelocity(body.angularVelocity);
     }
 }
 
+void ofApp::restoreSceneParams(const SceneSnapshot &snapshot) {
+    gravityOn = snapshot.params.gravityOn;
+    box2d.setGravity(snapshot.params.gravityX, snapshot.params.gravityY);
+    circleMin = snapshot.params.circleMin;
+    circleMax = snapshot.params.circleMax;
+    circleFreq = snapshot.params.circleFreq;
+    //the body cap belongs to the quality level running now, not the one that was saved
+    maxParticles = governor.getLevel().maxParticles;
+    trimParticles();
+    if(wallsOn != (bool)snapshot.params.wallsOn) {
+        wallsOn = snapshot.params.wallsOn;
+        if(wallsOn) addWalls();
+        else walls.clear();
+    }
+    params.set(P_GRAVITY_ON, gravityOn);
+    params.set(P_WALLS_ON, wallsOn);
+    params.set(P_CIRCLE_MIN, circleMin);
+    params.set(P_CIRCLE_MAX, circleMax);
+    params.set(P_CIRCLE_FREQ, circleFreq);
+    ofxUIToggle *gravityToggle = (ofxUIToggle *) gui3->getWidget("GRAVITY ON");
+    if(gravityToggle) gravityToggle->setValue(gravityOn);
+    ofxUIToggle *wallsToggle = (ofxUIToggle *) gui3->getWidget("WALLS ON");
+    if(wallsToggle) wallsToggle->setValue(wallsOn);
+}
 
 void ofApp::refreshGUIs(){
     gui0->loadSettings("PS3_Settings.xml");
@@ -373,121 +962,281 @@ void ofApp::refreshGUIs(){
 }
 
 
+//the scene is only drawn when the pacer says so, see update()
 void ofApp::draw()
 {
-    ofHideCursor();
-    ofShowCursor();
-    
-    
-    std::stringstream dir;
+    //the overlay text renders into its own fbos
+    updateOverlay();
+    //update() only returns once a present is due, every draw is one
+    drawScene();
+    pacer.presented();
+    //what the projectors show, before the gui goes on top
+    showRecorder.capture();
+    workSeconds += ofGetElapsedTimef() - workStart;
+}
+
+void ofApp::drawScene()
+{
     ofBackground(0);
     ofSetColor(255);
-    ofSetFrameRate(120);
-   //
     
-    dir << "App FPS: " << ofGetFrameRate() << std::endl;
-    dir << "Cam FPS: " << vidGrabber.getFPS() << std::endl;
-    
-    
-    videoTexture.draw(camWidth, 0, camWidth, camHeight);
+    //only what is drawn here gets uploaded this frame
+    if(params.get(P_SHOW_RAW).getBool()) videoTexture.draw(camWidth, 0, camWidth, camHeight);
     if(homographyReady) {
-        warpedColor.draw(0, 0);
+        warpedTexture.draw(0, 0);
     } else {
         videoTexture.draw(0,0);
     }
     
-    //drawing lines
-    ofSetColor(ofColor::red);
-    drawPoints(leftPoints);
-    ofSetColor(ofColor::blue);
-    drawPoints(rightPoints);
-    ofSetColor(128);
-    for(int i = 0; i < leftPoints.size(); i++) {
-        ofDrawLine(leftPoints[i], rightPoints[i]);
-    }
-    
-    dir << "Total Bodies: " << ofToString(box2d.getBodyCount()) << "\n";
-    dir << "Total Joints: " << ofToString(box2d.getJointCount()) << "\n\n";
-    
-    dir << "Directions:" << std::endl;
-    dir << "1) Use the PS3 Camera GUI to adjust your video image. Click 'save settings'." << std::endl;
-    dir << "2) Click 4 points on the right image to mark the corners of your screen." << std::endl;
-    dir << "3) Adjust the red points on the left by clicking and moving." << std::endl;
-    dir << "4) Click 'Save Homography' to save to file." << std::endl;
-    dir << "5) Press 'p' to mark the 4 corners of your projection area (top-left,top-right,bot-right,bot-left)" << std::endl;
-    dir << "6) Use the control panels to adjust tracking parameters, and add physics." << std::endl;
+    //calibration points and the lines between them
+    pointMesh.draw();
 
-    if(showTracker) drawTracker();
+    if(params.get(P_SHOW_TRACKER).getBool()) drawTracker();
 
-    
-    //after clicking 4 points in p mode this image should appear corrected.
-    //if(applyProjectorHomography) projectorWarp.draw(xOffset, 0, projectorWidth, projectorHeight);
-    //else warpedColor.draw(xOffset, 0, 1024, 768);
 
     //------box2D stuff-------------------
     
-    //walls
-    for (int i=0; i<walls.size(); i++) {
-        ofFill();
-        ofSetHexColor(0xc0dd3b);
-        walls[i].get()->draw();
-        
-        //ofDrawRectangle(displayWidth-200, 0, 30, 768);
+    //the walls never move, one mesh for all outputs
+    wallMesh.draw();
+    drawnBodies = walls.size();
+    //each output only draws the bodies inside it
+    for(int r=0; r<layout.regions.size(); r++) {
+        drawRegion(layout.regions[r]);
+    }
+
+    projectorMesh.draw();
+    drawCalibrationPattern();
+    drawOverlay();
+}
+
+//stats are formatted a few times a second, everything else only when its inputs change
+void ofApp::updateOverlay()
+{
+    if(statsText.isDue()) {
+        std::stringstream dir;
+        dir << "App FPS: " << ofGetFrameRate() << std::endl;
+        dir << "Cam FPS: " << vidGrabber.getFPS() << std::endl;
+        dir << "Quality: " << governor.getLevel().name << (governor.isEnabled() ? " (auto, " : " (manual, ")
+            << ofToString(governor.getAverageFrameMs(), 2) << " ms)" << std::endl;
+        dir << "Total Bodies: " << ofToString(box2d.getBodyCount()) << "\n";
+        dir << "Total Joints: " << ofToString(box2d.getJointCount()) << "\n";
+        dir << "Contour Vertices: " << contourVertices << " / " << vertexBudget << "\n";
+        vector<StageStats> stages = pipeline.getStats();
+        dir << "Pipeline (" << (pipeline.getPolicy() == PIPELINE_LATENCY ? "latency" : "throughput") << "):";
+        for(int i = 0; i < stages.size(); i++) {
+            dir << " " << stages[i].name << " " << stages[i].depth << "/" << stages[i].capacity
+                << " max " << stages[i].maxDepth << " drop " << stages[i].dropped;
+            if(stages[i].meanMs > 0) dir << " " << ofToString(stages[i].meanMs, 2) << "ms";
+            dir << (i + 1 < stages.size() ? " |" : "");
+        }
+        dir << "\n";
+        if(sdfParticles.getCount() > 0) {
+            dir << "SDF Particles: " << sdfParticles.getCount() << " (" << ofToString(sdfParticles.getUpdateMs(), 2) << " ms)\n";
+        }
+        if(pacer.enabled) {
+            dir << "Pacing: " << ofToString(pacer.getWakeRate(), 0) << " wakes/s, " << ofToString(pacer.getPresentRate(), 0) << " redraws/s, camera "
+                << ofToString(pacer.getCameraPeriodMs(), 2) << " ms, " << pacer.getDroppedSteps() << " physics steps dropped\n";
+        }
+        dir << "Silhouette Proxies: " << silhouettes.getProxyCount() << " (" << silhouettes.getRebuildCount() << " rebuilt)" << std::endl;
+        if(params.get(P_PUPPETS).getBool()) {
+            dir << "Puppets: " << puppetTemplates << " templates, " << shownPuppets.size() << " recognised, "
+                << puppetLookups << " lookups (" << ofToString(puppetMs, 2) << " ms)" << std::endl;
+        }
+        if(loopbackActive) {
+            dir << "Loopback udp: " << loopbackUdp.frames << " frames, " << loopbackUdp.gaps << " missing, "
+                << ofToString(loopbackUdp.latencyMs, 2) << " ms" << std::endl;
+            dir << "Loopback shm: " << loopbackShm.frames << " frames, " << loopbackShm.gaps << " missing, "
+                << ofToString(loopbackShm.latencyMs, 2) << " ms" << std::endl;
+        }
+        dir << "Bodies active/sleeping/frozen: " << activity.getCount(ACTIVITY_ACTIVE) << " / "
+            << activity.getCount(ACTIVITY_SLEEPING) << " / " << activity.getCount(ACTIVITY_FROZEN) << std::endl;
+        if(layout.regions.size() > 1) dir << "Projector outputs: " << layout.regions.size() << ", bodies drawn: " << drawnBodies << std::endl;
+        if(markProjectorBounds && markingRegion >= 0) dir << "Marking " << layout.regions[markingRegion].name << std::endl;
+        if(autoCalibration.isRunning()) dir << "Auto calibrating " << layout.regions[autoCalibration.getRegion()].name
+            << " " << ofToString(autoCalibration.getProgress() * 100, 0) << "%" << std::endl;
+        if(syntheticCheck.isBusy()) dir << "Synthetic calibration check running" << std::endl;
+        else if(syntheticCheck.getResult() != 0) dir << "Synthetic calibration check " << (syntheticCheck.getResult() > 0 ? "passed" : "FAILED")
+            << ", worst " << ofToString(syntheticCheck.getWorstError(), 2) << " px" << std::endl;
+        if(traceWriter.isOpen()) dir << "RECORDING " << tracePath << " (" << traceWriter.getFrameCount() << " frames)" << std::endl;
+        if(showRecorder.isRecording()) {
+            dir << "RECORDING SHOW " << showRecorder.getPath() << " (" << showRecorder.getWrittenCount() << " frames, "
+                << showRecorder.getDroppedCount() << " dropped, " << showRecorder.getQueueDepth() << " queued)" << std::endl;
+        }
+        statsText.setText(dir.str());
+    }
+
+    if(directionsText.isDue()) {
+        std::stringstream dir;
+        dir << "Directions:" << std::endl;
+        dir << "1) Use the PS3 Camera GUI to adjust your video image. Click 'save settings'." << std::endl;
+        dir << "2) Click 4 points on the right image to mark the corners of your screen." << std::endl;
+        dir << "3) Adjust the red points on the left by clicking and moving." << std::endl;
+        dir << "4) Click 'Save Homography' to save to file." << std::endl;
+        dir << "5) Press 'p' to mark the 4 corners of your projection area (top-left,top-right,bot-right,bot-left)" << std::endl;
+        dir << "   or press 'a' to calibrate steps 2-5 from projected patterns ('A' tries it on synthetic frames)." << std::endl;
+        dir << "6) Use the control panels to adjust tracking parameters, and add physics." << std::endl;
+        dir << "Press 'r' to record a contour trace, 'b' to benchmark physics on the last one, 't' to compare trackers on it, 'l' for a publish loopback check." << std::endl;
+        dir << "Press 'v' to record the projector outputs to video ('V' for raw frames)." << std::endl;
+        dir << "Press 'k' to learn the largest shadow as a new puppet ('K' adds another view of the last one).";
+        directionsText.setText(dir.str());
+    }
+
+    //walls are static bodies, they only change when they are added or cleared
+    OverlayKey wallKey;
+    wallKey.add((int)walls.size());
+    for(int i=0; i<walls.size(); i++) wallKey.add(walls[i]->getPosition());
+    if(wallMesh.isStale(wallKey)) {
+        ofMesh &mesh = wallMesh.mesh;
+        mesh.clear();
+        mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+        for(int i=0; i<walls.size(); i++) {
+            b2Body *body = walls[i]->body;
+            if(body == NULL) continue;
+            for(b2Fixture *f = body->GetFixtureList(); f != NULL; f = f->GetNext()) {
+                if(f->GetType() != b2Shape::e_polygon) continue;
+                b2PolygonShape *poly = (b2PolygonShape*)f->GetShape();
+                int base = mesh.getNumVertices();
+                for(int v=0; v<poly->m_count; v++) {
+                    b2Vec2 p = body->GetWorldPoint(poly->m_vertices[v]);
+                    mesh.addVertex(ofVec3f(p.x * OFX_BOX2D_SCALE, p.y * OFX_BOX2D_SCALE, 0));
+                    mesh.addColor(ofColor::fromHex(0xc0dd3b));
+                }
+                for(int v=2; v<poly->m_count; v++) mesh.addTriangle(base, base + v - 1, base + v);
+            }
+        }
+        wallMesh.setKey(wallKey);
+    }
+
+    OverlayKey projectorKey;
+    projectorKey.add((int)drawProjectorBounds);
+    for(int r=0; drawProjectorBounds && r<layout.regions.size(); r++) {
+        const ProjectorRegion &region = layout.regions[r];
+        projectorKey.add((int)region.calibrated).add((int)region.corners.size());
+        for(int i=0; i<region.corners.size(); i++) projectorKey.add(region.corners[i]);
     }
+    if(projectorMesh.isStale(projectorKey)) {
+        ofMesh &mesh = projectorMesh.mesh;
+        mesh.clear();
+        mesh.setMode(OF_PRIMITIVE_LINES);
+        for(int r=0; drawProjectorBounds && r<layout.regions.size(); r++) {
+            const vector<ofPoint> &corners = layout.regions[r].corners;
+            if(corners.size() < 2) continue;
+            //an output still being marked is left open
+            int segments = layout.regions[r].calibrated ? corners.size() : (int)corners.size() - 1;
+            for(int i=0; i<segments; i++) {
+                mesh.addVertex(corners[i]);
+                mesh.addVertex(corners[(i + 1) % corners.size()]);
+                mesh.addColor(ofColor(0, 0, 255));
+                mesh.addColor(ofColor(0, 0, 255));
+            }
+        }
+        projectorMesh.setKey(projectorKey);
+    }
+
+    OverlayKey pointKey;
+    pointKey.add((int)leftPoints.size()).add((int)rightPoints.size());
+    for(int i=0; i<leftPoints.size(); i++) pointKey.add(leftPoints[i]);
+    for(int i=0; i<rightPoints.size(); i++) pointKey.add(rightPoints[i]);
+    if(pointMesh.isStale(pointKey)) {
+        ofMesh &mesh = pointMesh.mesh;
+        mesh.clear();
+        mesh.setMode(OF_PRIMITIVE_LINES);
+        addPointMarks(mesh, leftPoints, ofColor::red);
+        addPointMarks(mesh, rightPoints, ofColor::blue);
+        for(int i = 0; i < MIN(leftPoints.size(), rightPoints.size()); i++) {
+            mesh.addVertex(leftPoints[i]);
+            mesh.addVertex(rightPoints[i]);
+            mesh.addColor(ofColor(128));
+            mesh.addColor(ofColor(128));
+        }
+        pointMesh.setKey(pointKey);
+    }
+}
+
+void ofApp::drawOverlay()
+{
+    statsText.draw(debugPos.x, debugPos.y);
+    directionsText.draw(debugPos.x, debugPos.y + statsText.getHeight() + 13);
+}
+
+
+//while auto calibrating every output is black except the one showing the pattern
+void ofApp::drawCalibrationPattern() {
+    int r = autoCalibration.getRegion();
+    if(r < 0) return;
+    if(autoCalibration.getPatternVersion() != patternVersion) {
+        patternVersion = autoCalibration.getPatternVersion();
+        patternTexture.markStale(autoCalibration.getPattern());
+    }
+    ofFill();
+    ofSetColor(0);
+    for(int i=0; i<layout.regions.size(); i++) ofDrawRectangle(layout.regions[i].viewport);
+    ofSetColor(255);
+    const ofRectangle &viewport = layout.regions[r].viewport;
+    patternTexture.draw(viewport.x, viewport.y, viewport.width, viewport.height);
+}
+
+//bounds of a box2d body, rotation is covered by using the farthest vertex as a radius
+static ofRectangle bodyBounds(const ofPoint &pos, float radius) {
+    return ofRectangle(pos.x - radius, pos.y - radius, radius*2, radius*2);
+}
+
+void ofApp::drawRegion(const ProjectorRegion &region) {
+    const ofRectangle &clip = region.viewport;
     
     // circles
+    ofFill();
+    ofSetHexColor(0xc0dd3b);
     for (int i=0; i<circles.size(); i++) {
-        ofFill();
-        ofSetHexColor(0xc0dd3b);
-        circles[i].get()->draw();
+        ofxBox2dCircle *circle = circles[i].get();
+        if(!clip.intersects(bodyBounds(circle->getPosition(), circle->getRadius()))) continue;
+        circle->draw();
+        drawnBodies++;
     }
     //polyshapes
     ofSetHexColor(0x444342);
     ofNoFill();
     for (int i=0; i<polyShapes.size(); i++) {
-        polyShapes[i].get()->draw();
-        ofDrawCircle(polyShapes[i].get()->getPosition(), 3);
+        ofxBox2dPolygon *poly = polyShapes[i].get();
+        ofRectangle local = poly->getBoundingBox();
+        float radius = MAX(MAX(fabs(local.getLeft()), fabs(local.getRight())), MAX(fabs(local.getTop()), fabs(local.getBottom())));
+        if(!clip.intersects(bodyBounds(poly->getPosition(), radius))) continue;
+        poly->draw();
+        ofDrawCircle(poly->getPosition(), 3);
+        drawnBodies++;
+    }
+    drawnBodies += silhouettes.draw(clip);
+    //sdf particles are in camera pixels, the output's homography places them
+    if(region.calibrated && sdfParticles.getCount() > 0) {
+        ofPushMatrix();
+        ofMultMatrix(region.getCameraToWindowMatrix(camWidth, camHeight));
+        sdfParticles.draw();
+        ofPopMatrix();
     }
     //particles
     for(int i=0; i<customParticles.size(); i++) {
-        customParticles[i].get()->draw();
-    }
-    
-
-    drawProjectorRect(); 
-     
-    
-    //ofSetColor(0, 0, 0);
-    ofDrawBitmapStringHighlight(dir.str(), debugPos + ofPoint(0,0));
-     
-    
-}
-
-
-void ofApp::drawProjectorRect() {
-    if(drawProjectorBounds) {
-        ofPolyline projShape;
-        projShape.addVertices(projectorPoints);
-        ofSetColor(0, 0, 255);
-        projShape.draw();
+        CustomParticle *particle = customParticles[i].get();
+        if(!clip.intersects(bodyBounds(particle->getPosition(), particle->getRadius()))) continue;
+        particle->draw();
+        drawnBodies++;
     }
 }
 
-
 void ofApp::drawTracker() {
     
-    RectTracker& tracker = contourFinder.getTracker();
     ofSetColor(255);
-    contourFinder.draw();
+    for(int i = 0; i < tracked.blobs.size(); i++) {
+        tracked.blobs[i].simplified.draw();
+    }
     
-    for(int i = 0; i < contourFinder.size(); i++) {
-        ofPoint center = toOf(contourFinder.getCenter(i));
+    for(int i = 0; i < tracked.blobs.size(); i++) {
+        const TrackedBlob &blob = tracked.blobs[i];
         ofPushMatrix();
-        ofTranslate(center.x, center.y);
-        int label = contourFinder.getLabel(i);
-        string msg = ofToString(label) + ":" + ofToString(tracker.getAge(label));
+        ofTranslate(blob.center.x, blob.center.y);
+        string msg = ofToString(blob.label) + ":" + ofToString(blob.age);
+        if(!blob.puppet.empty()) msg += " " + blob.puppet;
         ofDrawBitmapString(msg, 0, 0);
-        ofVec2f velocity = toOf(contourFinder.getVelocity(i));
+        ofVec2f velocity = blob.velocity;
         ofScale(5, 5);
         ofDrawLine(0, 0, velocity.x, velocity.y);
         ofPopMatrix();
@@ -495,18 +1244,49 @@ void ofApp::drawTracker() {
 
 }
 
-void ofApp::drawPoints(vector<ofVec2f>& points) {
-    ofNoFill();
+//a ring and a dot per point, as line segments for the overlay mesh
+void ofApp::addPointMarks(ofMesh &mesh, const vector<ofVec2f>& points, const ofColor &color) {
+    const float radii[2] = {10, 1};
+    const int   resolution[2] = {32, 8};
     for(int i = 0; i < points.size(); i++) {
-        ofDrawCircle(points[i], 10);
-        ofDrawCircle(points[i], 1);
+        for(int c = 0; c < 2; c++) {
+            for(int k = 0; k < resolution[c]; k++) {
+                float a0 = TWO_PI * k / resolution[c], a1 = TWO_PI * (k + 1) / resolution[c];
+                mesh.addVertex(ofVec3f(points[i].x + cos(a0) * radii[c], points[i].y + sin(a0) * radii[c], 0));
+                mesh.addVertex(ofVec3f(points[i].x + cos(a1) * radii[c], points[i].y + sin(a1) * radii[c], 0));
+                mesh.addColor(color);
+                mesh.addColor(color);
+            }
+        }
+    }
+}
+
+//builds the physics bodies for this frame's contours in the selected collider mode
+void ofApp::createSilhouettes(float seconds) {
+    if(silhouettes.getMode() == COLLIDER_HULL) {
+        for(int i = 0; i < tracked.blobs.size(); i++) {
+            //the run segmenter leaves blobs that no output shows without an outline
+            if(tracked.blobs[i].simplified.size() < 3) continue;
+            ofPolyline temp = tracked.blobs[i].simplified;
+            createBox2DShape(temp);
+        }
+        return;
+    }
+    
+    //chain and decomposed bodies are cached per tracker label
+    silhouettes.begin(tracked.blobs.size());
+    for(int i = 0; i < tracked.blobs.size(); i++) {
+        if(tracked.blobs[i].simplified.size() < 3) continue;
+        silhouettes.update(tracked.blobs[i].label, scalePolyShape(tracked.blobs[i].simplified), seconds);
     }
+    silhouettes.end();
 }
 
-//converts a contour into a box 2D shape
+//converts a contour into a single convex box 2D shape
 void ofApp::createBox2DShape(ofPolyline &daShape) {
+    //findContours returns the real (often concave) outline, box2d polygons must be convex
+    daShape = convexHull(daShape);
     daShape = daShape.getResampledByCount(b2_maxPolygonVertices);
-    //daShape = getConvexHull(shape); //we don't need this because contourfinder returns a convex hull
     shared_ptr<ofxBox2dPolygon> poly = shared_ptr<ofxBox2dPolygon>(new ofxBox2dPolygon);
     poly.get()->addVertices(scalePolyShape(daShape));
     poly.get()->setPhysics(1.0, 0.3, 0.3);
@@ -525,28 +1305,11 @@ vector<ofPoint> ofApp::scalePolyShape(ofPolyline shapeIn) {
     //THEORY:
     //use the homography to translate the points from 0,320 to the new homography coordinates.
     //then scale the points to the projector size
-    //then translate the points by the projectorPoints[0] point the top left origin
-    if(applyProjectorHomography) {
-        xScale = projectorWidth/camWidth;
-        yScale = projectorHeight/camHeight;
-        //translate point values between homography
-        std::vector<Point2f> ptsIn(pts.size());
-        std::vector<Point2f> ptsOut(pts.size());
-        for(int i=0; i<pts.size(); i++) {
-            ptsIn[i] = Point2f(pts[i].x,pts[i].y);
-        }
-        cv::perspectiveTransform(ptsIn, ptsOut, projectorHomography);
-        for(int i=0; i<pts.size(); i++) {
-            //copy points back in
-            pts[i].x = ptsOut[i].x;
-            pts[i].y = ptsOut[i].y;
-            //scale points to projector
-            pts[i].x *= xScale;
-            pts[i].y *= yScale;
-            //shift points by projector offset
-            pts[i].x += displayWidth;
-        }
-        
+    //then translate the points by the projector's viewport origin
+    //the whole shape goes to the output covering its centroid, so it stays one body
+    int r = pts.empty() ? -1 : layout.regionForCamera(shapeIn.getCentroid2D(), camWidth, camHeight);
+    if(r >= 0) {
+        layout.regions[r].cameraToWindow(pts, camWidth, camHeight);
     } else {
         for(int i=0; i<pts.size(); i++) {
             pts[i].x *= xScale;
@@ -560,146 +1323,255 @@ vector<ofPoint> ofApp::scalePolyShape(ofPolyline shapeIn) {
 //--------------------------------------------------------------
 void ofApp::guiEvent(ofxUIEventArgs &e)
 {
-    string name = e.widget->getName();
-    int kind = e.widget->getKind();
+    //every widget (and every value loaded from a settings file) lands in the registry,
+    //the stages that own the state pick the changes up from there
+    params.set(e.widget);
+    pacer.markChanged();
+}
+
+//registers every tunable once, with the same defaults as the gui widgets
+void ofApp::setupParams() {
+    //camera
+    params.addFloat("EXPOSURE", 150);
+    params.addFloat("BRIGHTNESS", 100);
+    params.addFloat("GAIN", 50);
+    params.addFloat("CONTRAST", 200);
+    params.addFloat("SHARPNESS", 0);
+    for(int i = 0; i < numCameraModes; i++) params.addBool(cameraModes[i].name, i == 0);
+    params.addBool("EXPORT FRAMES", false);
+    params.addTrigger("SAVE SETTINGS").onChange = [this](float) { gui0->saveSettings("PS3_Settings.xml"); };
     
     //homography
-    if(name == "CLEAR HOMOGRAPHY") {
-        clearPoints();
-    }
-    else if(name == "REFRESH GUIS") {
-        refreshGUIs();
-    }
-    else if (name == "SAVE HOMOGRAPHY") {
+    params.addBool("  MIRROR FULLSCREEN", true);
+    params.addBool("  TOGGLE FULLSCREEN", false).onChange = [this](float v) {
+        fullScreen = v != 0;
+        ofSetFullscreen(fullScreen);
+    };
+    params.addBool("  LOCK/UNLOCK POINTS", false);
+    params.addBool("  SHOW RAW PREVIEW", true);
+    params.addBool("  AUTO QUALITY", false);
+    params.addBool("  FAVOR THROUGHPUT", false);
+    params.addBool("  FRAME PACING", true);
+    params.addTrigger("CLEAR HOMOGRAPHY").onChange = [this](float) { clearPoints(); };
+    params.addTrigger("SAVE HOMOGRAPHY").onChange = [this](float) {
         saveMatrix = true;
         gui1->saveSettings("Homography_Settings.xml");
+    };
+    params.addTrigger("REFRESH GUIS").onChange = [this](float) { refreshGUIs(); };
+    
+    //tracking
+    params.addBool("SHOW/HIDE TRACKING", true);
+    params.addBool("INVERT TRACKING", true);
+    params.addFloat("THRESHOLD", 128);
+    params.addFloat("MIN AREA RADIUS", 15);
+    params.addFloat("MAX AREA RADIUS", 100);
+    params.addFloat("PERSISTENCE", 15);
+    params.addFloat("MAX DISTANCE", 32);
+    params.addFloat("VERTEX BUDGET", 512);
+    params.addBool("HASHED TRACKER", false);
+    params.addBool("RUN SEGMENTER", false);
+    params.addBool("PUPPET RECOGNITION", false);
+    params.addFloat("PUPPET DISTANCE", 1);
+    params.addBool("PUBLISH UDP", false);
+    params.addBool("PUBLISH OSC", false);
+    params.addBool("PUBLISH SHM", false);
+    params.addTrigger("SAVE TRACKING").onChange = [this](float) { gui2->saveSettings("Tracking_Settings.xml"); };
+    
+    //box2d
+    params.addBool("GRAVITY ON", true);
+    params.addBool("WALLS ON", true);
+    params.addFloat("CIRCLE MIN", 2);
+    params.addFloat("CIRCLE MAX", 20);
+    params.addFloat("CIRCLE FREQ", 20);
+    params.addBool("HULL", true);
+    params.addBool("CHAIN", false);
+    params.addBool("DECOMPOSED", false);
+    params.addFloat("COLLIDER FIDELITY", 48);
+    params.addFloat("COLLIDER PROXIES", 256);
+    params.addBool("ACTIVITY LOD", false);
+    params.addFloat("INFLUENCE RADIUS", 150);
+    params.addFloat("SDF PARTICLES", 0);
+    params.addBool("SDF SMOKE", false);
+    params.addTrigger("ADD CIRCLE");
+    params.addTrigger("ADD PARTICLES");
+    params.addTrigger("CLEAR SHAPES");
+    params.addTrigger("SAVE BOX2D").onChange = [this](float) { gui3->saveSettings("Box2d_Settings.xml"); };
+    
+    params.seal();
+}
+
+//capture stage: camera controls go over usb, so only send the ones that changed
+void ofApp::applyCameraParams() {
+    if(cameraParams.changed(params.get(P_EXPOSURE)))   vidGrabber.setExposure((uint8_t)params.get(P_EXPOSURE).get());
+    if(cameraParams.changed(params.get(P_BRIGHTNESS))) vidGrabber.setBrightness((uint8_t)params.get(P_BRIGHTNESS).get());
+    if(cameraParams.changed(params.get(P_GAIN)))       vidGrabber.setGain((uint8_t)params.get(P_GAIN).get());
+    if(cameraParams.changed(params.get(P_CONTRAST)))   vidGrabber.setContrast((uint8_t)params.get(P_CONTRAST).get());
+    if(cameraParams.changed(params.get(P_SHARPNESS)))  vidGrabber.setSharpness((uint8_t)params.get(P_SHARPNESS).get());
+    
+    //the mode radio is one toggle per mode, follow the one just switched on
+    vector<ParamId> modes;
+    for(int i = 0; i < numCameraModes; i++) modes.push_back(paramId(cameraModes[i].name));
+    int mode = pickRadio(cameraParams, modes);
+    if(mode < 0 || setCameraMode(mode)) return;
+    
+    //the camera is still in the old mode, show that one again
+    for(int i = 0; i < numCameraModes; i++) {
+        const CameraMode &running = cameraModes[i];
+        bool on = running.width == camWidth && running.height == camHeight && running.fps == camFrameRate;
+        params.set(modes[i], on);
+        if(on) ((ofxUIRadio *) gui0->getWidget("CAMERA MODE"))->activateToggle(running.name);
     }
-    else if (name == "  MIRROR FULLSCREEN") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        bool mirror = temp->getValue();
-        mirrorLeft = mirror;
-    }
-    else if (name == "  TOGGLE FULLSCREEN") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        fullScreen = temp->getValue();
-        ofSetFullscreen(fullScreen);
-    }
-    else if (name == "  LOCK/UNLOCK POINTS") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        lockHomography = temp->getValue();
-    }
-    //camera settings
-    else if (name == "EXPOSURE") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        vidGrabber.setExposure((uint8_t)holdme);
-    }
-    else if (name == "BRIGHTNESS") {
-        ofxUISlider *exp = (ofxUISlider *) e.widget;
-        float holdme = exp->getValue();
-        vidGrabber.setBrightness((uint8_t)holdme);
-    }
-    else if (name == "SHARPNESS") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        vidGrabber.setSharpness((uint8_t)holdme);
-    }
-    else if (name == "CONTRAST") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        vidGrabber.setContrast((uint8_t)holdme);
+}
+
+//a radio is one registry toggle per option, and ofxUI only sends an event for the
+//toggle that was clicked. returns the option switched on since the watcher last
+//looked, or -1, and switches the others off so a stale one can't shadow it later
+int ofApp::pickRadio(ParamWatcher &watcher, const vector<ParamId> &options) {
+    int picked = -1;
+    for(int i = 0; i < options.size(); i++) {
+        if(watcher.changed(params.get(options[i])) && params.get(options[i]).getBool() && picked < 0) picked = i;
     }
-    else if (name == "GAIN") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        vidGrabber.setGain((uint8_t)holdme);
+    if(picked < 0) return -1;
+    for(int i = 0; i < options.size(); i++) {
+        if(i != picked && params.get(options[i]).getBool()) params.set(options[i], 0);
     }
-    else if (name == "SAVE SETTINGS") {
-        gui0->saveSettings("PS3_Settings.xml");
+    return picked;
+}
+
+//tracking stage
+void ofApp::applyTrackingParams() {
+    mirrorLeft = params.get(P_MIRROR).getBool();
+    lockHomography = params.get(P_LOCK_POINTS).getBool();
+    if(trackingParams.changed(params.get(P_VERTEX_BUDGET))) vertexBudget = params.get(P_VERTEX_BUDGET).get();
+    if(trackingParams.changed(params.get(P_FRAME_PACING))) {
+        //paced, the loop sleeps in the pacer instead of in openFrameworks' frame limiter
+        pacer.enabled = params.get(P_FRAME_PACING).getBool();
+        ofSetFrameRate(pacer.enabled ? 0 : 120);
     }
-    //tracking
-    else if (name == "SHOW/HIDE TRACKING") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        showTracker = temp->getValue();
+    if(trackingParams.changed(params.get(P_THROUGHPUT))) {
+        pipeline.setPolicy(params.get(P_THROUGHPUT).getBool() ? PIPELINE_THROUGHPUT : PIPELINE_LATENCY);
     }
-    else if (name == "INVERT TRACKING") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        contourFinder.setInvert(temp->getValue());
+}
+
+//runs in the track stage, which owns the contour finder, exporter and publisher.
+//sizes in the gui are 320x240 pixels and get scaled to the camera mode.
+void ofApp::applyVisionParams(float pixelScale) {
+    bool rescaled = pixelScale != visionScale;
+    visionScale = pixelScale;
+    if(visionParams.changed(params.get(P_INVERT)))       contourFinder.setInvert(params.get(P_INVERT).getBool());
+    if(visionParams.changed(params.get(P_THRESHOLD)))    contourFinder.setThreshold(params.get(P_THRESHOLD).get());
+    if(visionParams.changed(params.get(P_MIN_RADIUS)) || rescaled) {
+        float radius = params.get(P_MIN_RADIUS).get() * pixelScale;
+        contourFinder.setMinAreaRadius(radius);
+        segmenter.minArea = PI * radius * radius;
     }
-    else if (name == "THRESHOLD") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        contourFinder.setThreshold(holdme);
+    if(visionParams.changed(params.get(P_MAX_RADIUS)) || rescaled) {
+        float radius = params.get(P_MAX_RADIUS).get() * pixelScale;
+        contourFinder.setMaxAreaRadius(radius);
+        segmenter.maxArea = PI * radius * radius;
     }
-    else if (name == "MIN AREA RADIUS") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        contourFinder.setMinAreaRadius(holdme);
+    if(visionParams.changed(params.get(P_PERSISTENCE)))  contourFinder.getTracker().setPersistence(params.get(P_PERSISTENCE).get());
+    if(visionParams.changed(params.get(P_MAX_DISTANCE)) || rescaled) contourFinder.getTracker().setMaximumDistance(params.get(P_MAX_DISTANCE).get() * pixelScale);
+    blobTracker.persistence = params.get(P_PERSISTENCE).get();
+    blobTracker.maximumDistance = params.get(P_MAX_DISTANCE).get() * pixelScale;
+    //labels of one tracker mean nothing to the other
+    if(visionParams.changed(params.get(P_HASHED_TRACKER))) blobTracker.reset();
+    bool puppetsChanged = visionParams.changed(params.get(P_PUPPETS));
+    if(visionParams.changed(params.get(P_PUPPET_DISTANCE)) || puppetsChanged) {
+        puppets.maxDistance = params.get(P_PUPPET_DISTANCE).get();
+        puppets.reset();
     }
-    else if (name == "MAX AREA RADIUS") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        contourFinder.setMaxAreaRadius(holdme);
+    if(visionParams.changed(params.get(P_EXPORT_FRAMES))) {
+        if(params.get(P_EXPORT_FRAMES).getBool()) frameExporter.setup("shadowPuppetry");
+        else frameExporter.close();
     }
-    else if (name == "PERSISTENCE") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        contourFinder.getTracker().setPersistence(holdme);
+    
+    bool udpChanged = visionParams.changed(params.get(P_PUBLISH_UDP));
+    bool oscChanged = visionParams.changed(params.get(P_PUBLISH_OSC));
+    if(udpChanged || oscChanged) {
+        bool udp = params.get(P_PUBLISH_UDP).getBool();
+        bool osc = params.get(P_PUBLISH_OSC).getBool();
+        if(udp || osc) publisher.setupUdp(publishHost, publishPort, osc);
+        else publisher.closeUdp();
     }
-    else if (name == "MAX DISTANCE") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        float holdme = temp->getValue();
-        contourFinder.getTracker().setMaximumDistance(holdme);
+    if(visionParams.changed(params.get(P_PUBLISH_SHM))) {
+        if(params.get(P_PUBLISH_SHM).getBool()) publisher.setupSharedMemory(publishShmName);
+        else publisher.closeSharedMemory();
     }
-    else if (name == "SAVE TRACKING") {
-        gui2->saveSettings("Tracking_Settings.xml");
+}
+
+//physics stage: toggles become events only when they differ from the world's state
+void ofApp::applyPhysicsParams() {
+    bool gravity = params.get(P_GRAVITY_ON).getBool();
+    if(gravity != gravityOn) physicsEvent(gravity ? PHYSICS_GRAVITY_ON : PHYSICS_GRAVITY_OFF);
+    bool walls = params.get(P_WALLS_ON).getBool();
+    if(walls != wallsOn) physicsEvent(walls ? PHYSICS_WALLS_ON : PHYSICS_WALLS_OFF);
+    
+    if(physicsParams.changed(params.get(P_CIRCLE_MIN)))  circleMin = params.get(P_CIRCLE_MIN).get();
+    if(physicsParams.changed(params.get(P_CIRCLE_MAX)))  circleMax = params.get(P_CIRCLE_MAX).get();
+    if(physicsParams.changed(params.get(P_CIRCLE_FREQ))) circleFreq = params.get(P_CIRCLE_FREQ).get();
+    if(physicsParams.changed(params.get(P_FIDELITY)))    silhouettes.fidelity = params.get(P_FIDELITY).get();
+    if(physicsParams.changed(params.get(P_PROXIES)))     silhouettes.maxProxies = params.get(P_PROXIES).get();
+    if(physicsParams.changed(params.get(P_INFLUENCE)))   activity.influenceRadius = params.get(P_INFLUENCE).get();
+    if(physicsParams.changed(params.get(P_SDF_COUNT)))   sdfCount = params.get(P_SDF_COUNT).get();
+    if(physicsParams.changed(params.get(P_SDF_SMOKE)))   sdfParticles.mode = params.get(P_SDF_SMOKE).getBool() ? SDF_SMOKE : SDF_SAND;
+    if(physicsParams.changed(params.get(P_ACTIVITY_LOD))) {
+        activity.enabled = params.get(P_ACTIVITY_LOD).getBool();
+        if(!activity.enabled) activity.wakeAll();
     }
     
-    //------------------BOX 2D MODDING -------------------//
+    //the collider radio is three toggles in ColliderMode order
+    vector<ParamId> colliders;
+    colliders.push_back(P_COLLIDER_HULL);
+    colliders.push_back(P_COLLIDER_CHAIN);
+    colliders.push_back(P_COLLIDER_DECOMP);
+    int collider = pickRadio(physicsParams, colliders);
+    if(collider >= 0) silhouettes.setMode((ColliderMode)collider);
+    
+    for(int n = params.get(P_ADD_CIRCLE).consume(); n > 0; n--) physicsEvent(PHYSICS_ADD_CIRCLE);
+    for(int n = params.get(P_ADD_PARTICLES).consume(); n > 0; n--) physicsEvent(PHYSICS_ADD_PARTICLES);
+    for(int n = params.get(P_CLEAR_SHAPES).consume(); n > 0; n--) physicsEvent(PHYSICS_CLEAR_SHAPES);
+}
+
+//--------------------------------------------------------------
+//physics actions from the gui, kept in one place so a trace replay can repeat them
+void ofApp::physicsEvent(const TraceEvent &trace) {
+    traceWriter.addEvent(trace);
+    PhysicsEvent event = trace.type;
     
-    else if (name == "WALLS ON") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        wallsOn = temp->getValue();
+    if(event == PHYSICS_WALLS_ON || event == PHYSICS_WALLS_OFF) {
+        wallsOn = event == PHYSICS_WALLS_ON;
+        activity.wakeAll();
         if(wallsOn) {
             addWalls();
         } else {
             walls.clear();
         }
     }
-    else if (name == "GRAVITY ON") {
-        ofxUIToggle *temp = (ofxUIToggle *) e.widget;
-        gravityOn = temp->getValue();
+    else if(event == PHYSICS_GRAVITY_ON || event == PHYSICS_GRAVITY_OFF) {
+        gravityOn = event == PHYSICS_GRAVITY_ON;
+        activity.wakeAll();
         if(gravityOn) {
             box2d.setGravity(20.0, 0.0);
         } else {
             box2d.setGravity(0.0, 0.0);
         }
     }
-    else if (name == "ADD CIRCLE") {
+    else if(event == PHYSICS_ADD_CIRCLE) {
+        if(circles.size() + customParticles.size() >= maxParticles) return;
         float r = ofRandom(4, 20);
-        float x = ofRandom(displayWidth, displayWidth+projectorWidth);
+        float x = ofRandom(layout.getOutputBounds().getLeft(), layout.getOutputBounds().getRight());
         float y = ofRandom(0, -100);
         circles.push_back(shared_ptr<ofxBox2dCircle>(new ofxBox2dCircle));
         circles.back().get()->setPhysics(3.0, 0.53, 0.1);
         circles.back().get()->setup(box2d.getWorld(), x, y, r);
     }
-    else if (name == "CIRCLE MIN") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        circleMin = temp->getValue();
-    }
-    else if (name == "CIRCLE MAX") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        circleMax = temp->getValue();
-    }
-    else if (name == "CIRCLE FREQ") {
-        ofxUISlider *temp = (ofxUISlider *) e.widget;
-        circleFreq = temp->getValue();
-    }
-    else if (name == "ADD PARTICLES") {
+    else if(event == PHYSICS_ADD_PARTICLES) {
+        if(circles.size() + customParticles.size() >= maxParticles) return;
         customParticles.push_back(shared_ptr<CustomParticle>(new CustomParticle));
         CustomParticle * p = customParticles.back().get();
         float r = ofRandom(3, 20);
-        float x = ofRandom(displayWidth, displayWidth+projectorWidth);
+        float x = ofRandom(layout.getOutputBounds().getLeft(), layout.getOutputBounds().getRight());
         float y = ofRandom(0, -100);
         p->setPhysics(0.4, 0.53, 0.31);
         p->setup(box2d.getWorld(), x, y, r);
@@ -707,19 +1579,271 @@ void ofApp::guiEvent(ofxUIEventArgs &e)
         p->color.g = 0;
         p->color.b = ofRandom(150, 255);
     }
-    else if (name == "CLEAR SHAPES") {
+    else if(event == PHYSICS_CLEAR_SHAPES) {
         circles.clear();
         customParticles.clear();
     }
-    else if (name == "SAVE BOX2D") {
-        gui3->saveSettings("Box2d_Settings.xml");
+    else if(event == PHYSICS_CLEAR_CIRCLES) {
+        shape.clear();
+        polyShapes.clear();
+        circles.clear();
+    }
+    else if(event == PHYSICS_DROP_CIRCLE) {
+        shared_ptr<ofxBox2dCircle> circle = shared_ptr<ofxBox2dCircle>(new ofxBox2dCircle);
+        circle.get()->setPhysics(0.3, 0.5, 0.1);
+        circle.get()->setup(box2d.getWorld(), trace.at.x, trace.at.y, ofRandom(10, 20));
+        circles.push_back(circle);
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::toggleTraceRecording() {
+    if(traceWriter.isOpen()) {
+        ofLogNotice("ContourTrace") << "recorded " << traceWriter.getFrameCount() << " frames to " << tracePath;
+        traceWriter.close();
+        return;
+    }
+    //seed the random generator so gui events that use ofRandom replay identically
+    uint32_t seed = ofGetSystemTime();
+    ofSeedRandom(seed);
+    ofDirectory::createDirectory("traces", true, true);
+    tracePath = "traces/" + ofGetTimestampString("%Y%m%d-%H%M%S") + ".trace";
+    if(traceWriter.open(tracePath, seed, camWidth, camHeight)) {
+        //a replay starts from the defaults, the first frame brings it to the current state
+        traceWriter.addEvent(wallsOn ? PHYSICS_WALLS_ON : PHYSICS_WALLS_OFF);
+        traceWriter.addEvent(gravityOn ? PHYSICS_GRAVITY_ON : PHYSICS_GRAVITY_OFF);
+        ofLogNotice("ContourTrace") << "recording to " << tracePath;
+    }
+}
+
+//records the projector outputs to data/shows, as a video or a ppm per frame
+void ofApp::toggleShowRecording(RecorderOutput output) {
+    if(showRecorder.isRecording()) {
+        showRecorder.stop();
+        return;
+    }
+    ofDirectory::createDirectory("shows", true, true);
+    string name = "shows/" + ofGetTimestampString("%Y%m%d-%H%M%S") + (output == RECORD_FFMPEG ? ".mp4" : "");
+    showRecorder.start(ofToDataPath(name, true), output, layout.getOutputBounds(), 30);
+}
+
+//replays a recorded trace straight into the physics for a fixed number of
+//steps with no vision stage, and logs timing and a checksum of the result.
+void ofApp::runReplayBenchmark(const string &path, int steps) {
+    ContourTraceReader reader;
+    if(!reader.open(path)) return;
+    if(traceWriter.isOpen()) toggleTraceRecording();
+    //the simplifier belongs to the track stage, hold it for the run
+    pipeline.pause();
+    
+    //start every run from the same empty world with the full quality settings,
+    //so two runs of one trace do the same work whatever the governor did live
+    circles.clear();
+    customParticles.clear();
+    polyShapes.clear();
+    shape.clear();
+    silhouettes.clear();
+    silhouetteSeconds = 0;
+    silhouettesStale = true;
+    walls.clear();
+    addWalls();
+    wallsOn = true;
+    box2d.setGravity(20.0, 0.0);
+    gravityOn = true;
+    const QualityLevel &full = governor.levels[0];
+    box2d.setIterations(full.velocityIterations, full.positionIterations);
+    maxParticles = full.maxParticles;
+    silhouettes.fidelity = full.colliderFidelity;
+    const ContourTraceHeader &header = reader.getHeader();
+    simplifier.reset();
+    simplifier.vertexBudget = full.vertexBudget;
+    simplifier.pixelScale = header.camWidth / 320.0f;
+    activity.reset();
+    ofSeedRandom(header.seed);
+    
+    //the outlines are in the recording camera's pixels, map them with its size
+    //whatever mode the camera is in now
+    int liveWidth = camWidth, liveHeight = camHeight;
+    camWidth = header.camWidth;
+    camHeight = header.camHeight;
+    for(int r=0; r<layout.regions.size(); r++) {
+        if(layout.regions[r].corners.size() == 4) layout.regions[r].calibrate(camWidth, camHeight);
+    }
+    
+    TrackingFrame frame;
+    vector<TraceEvent> events;
+    unsigned long long total = 0, worst = 0;
+    for(int step=0; step<steps; step++) {
+        if(!reader.readFrame(frame, events)) {
+            reader.rewind();
+            if(!reader.readFrame(frame, events)) break;
+        }
+        unsigned long long start = ofGetElapsedTimeMicros();
+        for(int i=0; i<events.size(); i++) physicsEvent(events[i]);
+        tracked = frame;
+        simplifier.simplify(tracked.blobs);
+        ofRemove(circles, shouldRemove);
+        ofRemove(customParticles, shouldRemove);
+        polyShapes.clear();
+        createSilhouettes(1.0f / box2dFps);
+        updateBox2DForces();
+        box2d.update();
+        unsigned long long elapsed = ofGetElapsedTimeMicros() - start;
+        total += elapsed;
+        worst = MAX(worst, elapsed);
     }
     
+    //position checksum so two runs can be compared for identical results
+    double checksum = 0;
+    for(int i=0; i<circles.size(); i++) checksum += circles[i]->getPosition().x * 1.3 + circles[i]->getPosition().y;
+    for(int i=0; i<customParticles.size(); i++) checksum += customParticles[i]->getPosition().x * 1.7 + customParticles[i]->getPosition().y;
+    
+    ofLogNotice("ContourTrace") << "replayed " << path << " for " << steps << " steps: "
+        << total / 1000.0 << " ms total, " << (double)total / MAX(steps, 1) / 1000.0 << " ms/step mean, "
+        << worst / 1000.0 << " ms worst, " << box2d.getBodyCount() << " bodies, checksum " << ofToString(checksum, 4);
+    //back to what the live show runs at, the gui follows the trace's walls and gravity
+    camWidth = liveWidth;
+    camHeight = liveHeight;
+    for(int r=0; r<layout.regions.size(); r++) {
+        if(layout.regions[r].corners.size() == 4) layout.regions[r].calibrate(camWidth, camHeight);
+    }
+    simplifier.reset();
+    applyGovernedQuality();
+    params.set(P_WALLS_ON, wallsOn);
+    params.set(P_GRAVITY_ON, gravityOn);
+    ofxUIToggle *gravityToggle = (ofxUIToggle *) gui3->getWidget("GRAVITY ON");
+    if(gravityToggle) gravityToggle->setValue(gravityOn);
+    ofxUIToggle *wallsToggle = (ofxUIToggle *) gui3->getWidget("WALLS ON");
+    if(wallsToggle) wallsToggle->setValue(wallsOn);
+    pipeline.resume();
+}
+
+//label continuity and cost of one tracker over a trace
+struct TrackerReport {
+    TrackerReport() : frames(0), blobs(0), continued(0), jumps(0), totalMicros(0), worstMicros(0) {}
+    struct Seen {
+        ofVec2f centroid, velocity;
+    };
+    void add(const vector<int> &labelList, const vector<ofVec2f> &centroids, unsigned long long micros, float maxDistance) {
+        map<int, Seen> current;
+        for(int i=0; i<labelList.size(); i++) {
+            Seen &seen = current[labelList[i]];
+            seen.centroid = centroids[i];
+            seen.velocity.set(0, 0);
+            map<int, Seen>::iterator prev = previous.find(labelList[i]);
+            if(prev != previous.end()) {
+                continued++;
+                //kept its label but landed further from where it was heading than a match
+                //may: most likely a swap. fast blobs that keep going don't count
+                ofVec2f predicted = prev->second.centroid + prev->second.velocity;
+                if(predicted.distance(centroids[i]) > maxDistance) jumps++;
+                seen.velocity = centroids[i] - prev->second.centroid;
+            }
+            labels.insert(labelList[i]);
+        }
+        previous.swap(current);
+        frames++;
+        blobs += labelList.size();
+        totalMicros += micros;
+        worstMicros = MAX(worstMicros, micros);
+    }
+    void log(const string &name) const {
+        ofLogNotice("TrackerBenchmark") << name << ": " << frames << " frames, " << blobs << " blobs, "
+            << labels.size() << " labels, continuity " << ofToString(100.0 * continued / MAX(blobs, 1ull), 1) << "%, "
+            << jumps << " jumps, " << ofToString((double)totalMicros / MAX(frames, 1ull), 1) << " us/frame mean, "
+            << worstMicros << " us worst";
+    }
+    unsigned long long frames, blobs, continued, jumps, totalMicros, worstMicros;
+    set<int> labels;
+    map<int, Seen> previous;
+};
+
+//replays the contours of a trace through the RectTracker and the BlobTracker
+//with the current tracking settings and logs how well each keeps its labels
+void ofApp::runTrackerBenchmark(const string &path) {
+    ContourTraceReader reader;
+    if(!reader.open(path)) return;
+    float pixelScale = reader.getHeader().camWidth / 320.0f;
+    int persistence = params.get(P_PERSISTENCE).get();
+    float maxDistance = params.get(P_MAX_DISTANCE).get() * pixelScale;
+    
+    RectTracker rectTracker;
+    rectTracker.setPersistence(persistence);
+    rectTracker.setMaximumDistance(maxDistance);
+    BlobTracker hashedTracker;
+    hashedTracker.persistence = persistence;
+    hashedTracker.maximumDistance = maxDistance;
+    
+    TrackerReport rectReport, hashedReport;
+    TrackingFrame frame;
+    vector<TraceEvent> events;
+    while(reader.readFrame(frame, events)) {
+        vector<cv::Rect> rects;
+        vector<ofVec2f> centroids;
+        for(int i=0; i<frame.blobs.size(); i++) {
+            rects.push_back(toCv(frame.blobs[i].bounds));
+            centroids.push_back(frame.blobs[i].centroid);
+        }
+        
+        unsigned long long start = ofGetElapsedTimeMicros();
+        const vector<unsigned int> &rectLabels = rectTracker.track(rects);
+        unsigned long long elapsed = ofGetElapsedTimeMicros() - start;
+        rectReport.add(vector<int>(rectLabels.begin(), rectLabels.end()), centroids, elapsed, maxDistance);
+        
+        start = ofGetElapsedTimeMicros();
+        hashedTracker.track(frame.blobs);
+        elapsed = ofGetElapsedTimeMicros() - start;
+        vector<int> hashedLabels;
+        for(int i=0; i<frame.blobs.size(); i++) hashedLabels.push_back(frame.blobs[i].label);
+        hashedReport.add(hashedLabels, centroids, elapsed, maxDistance);
+    }
+    ofLogNotice("TrackerBenchmark") << path;
+    rectReport.log("RectTracker");
+    hashedReport.log("BlobTracker");
+}
+
+//--------------------------------------------------------------
+//listens to our own published output on this machine and reports what arrives
+void ofApp::toggleLoopback() {
+    loopbackActive = !loopbackActive;
+    loopback.close();
+    if(loopbackActive) {
+        bool osc = params.get(P_PUBLISH_OSC).getBool();
+        bool udp = loopback.listenUdp(publishPort, osc);
+        bool shm = loopback.openSharedMemory(publishShmName);
+        ofLogNotice("TrackingReceiver") << "loopback check: udp " << (udp ? "listening" : "off")
+            << ", shared memory " << (shm ? "open" : "not available");
+        loopbackUdp = LoopbackStats();
+        loopbackShm = LoopbackStats();
+    }
+}
+
+void ofApp::checkLoopback() {
+    TrackingFrame frame;
+    LoopbackStats* stats[2] = { &loopbackUdp, &loopbackShm };
+    for(int source=0; source<2; source++) {
+        LoopbackStats &s = *stats[source];
+        while(source == 0 ? loopback.receiveUdp(frame) : loopback.receiveSharedMemory(frame)) {
+            if(s.frames > 0 && frame.sequence > s.lastSequence + 1) s.gaps += frame.sequence - s.lastSequence - 1;
+            s.lastSequence = frame.sequence;
+            s.latencyMs = (ofGetSystemTimeMicros() - frame.captureMicros) / 1000.0;
+            s.blobs = frame.blobs.size();
+            s.frames++;
+        }
+    }
 }
 
 //--------------------------------------------------------------
 void ofApp::exit()
 {
+    pipeline.stop();
+    SceneSnapshot snapshot;
+    captureScene(snapshot);
+    snapshotWriter.submit(snapshot);
+    snapshotWriter.stop();
+    traceWriter.close();
+    showRecorder.stop();
+    syntheticCheck.stop();
     delete gui0;
 }
 
@@ -750,6 +1874,7 @@ bool ofApp::movePoint(vector<ofVec2f>& points, ofVec2f point, int LeftOrRight) {
 }
 
 void ofApp::mousePressed(int x, int y, int button) {
+    pacer.markChanged();
     if(!markProjectorBounds) {
         if(!lockHomography) {
             if((x < camWidth*2) && (y<camHeight)) {
@@ -766,43 +1891,71 @@ void ofApp::mousePressed(int x, int y, int button) {
             }
         }
     } else {
-        //each click adds a point to the vector
-        projectorPoints.push_back(ofPoint(x,y));
-        writeProjectorPoints();
+        //the first click picks the output being marked, each click adds a corner
+        if(markingRegion < 0) {
+            markingRegion = MAX(layout.regionAt(x, y), 0);
+            layout.regions[markingRegion].corners.clear();
+            layout.regions[markingRegion].calibrated = false;
+        }
+        layout.regions[markingRegion].corners.push_back(ofPoint(x,y));
+        writeProjectorPoints(markingRegion);
     }
 }
 
 
-void ofApp::writeProjectorPoints() {
-    if(projectorPoints.size() ==4) {
-        
-        //reset the box2d world.
-        box2d.createGround(ofPoint(projectorPoints[3].x,projectorPoints[3].y), ofPoint(projectorPoints[2].x, projectorPoints[2].y));
+void ofApp::writeProjectorPoints(int index) {
+    ProjectorRegion &region = layout.regions[index];
+    if(region.corners.size() ==4) {
         
         //find the projector homography once
-        float ratio = camWidth/projectorWidth;
-        vector<Point2f> srcPoints;
-        vector<Point2f> dstPoints;
-        for(int i=0; i<projectorPoints.size(); i++){
-            //shift and scale points
-            dstPoints.push_back(Point2f((projectorPoints[i].x-displayWidth)*ratio, projectorPoints[i].y*ratio));
-            if(markProjectorBounds) saveProjectorPoint(ofVec2f(projectorPoints[i].x, projectorPoints[i].y), i);
-        }
-        
-        srcPoints.push_back(Point2f(0.0, 0.0));
-        srcPoints.push_back(Point2f((float)camWidth, 0.0));
-        srcPoints.push_back(Point2f((float)camWidth, (float)camHeight));
-        srcPoints.push_back(Point2f(0.0, (float)camHeight));
-        projectorHomography = findHomography(Mat(srcPoints), Mat(dstPoints));
-        applyProjectorHomography = true;   //might be nice to make sure it calculated correctly.
+        if(!region.calibrate(camWidth, camHeight)) ofLogWarning("projectors") << "could not calibrate " << region.name;
+        layout.save();
         
-        //add a 5th point to draw the complete outline.
-        ofPoint first = projectorPoints[0];
-        projectorPoints.push_back(first);
+        //reset the box2d world.
+        createGround();
         
         drawProjectorBounds=true;
         markProjectorBounds=false;
+        markingRegion = -1;
+    }
+}
+
+//takes the camera points and output corners from the decoded patterns,
+//as if they had been clicked, and saves them like the clicked ones
+void ofApp::finishAutoCalibration() {
+    Mat solved;
+    vector<ofVec2f> cameraCorners, warpedCorners;
+    if(!autoCalibration.solve(layout, mirrorLeft, solved, cameraCorners, warpedCorners)) {
+        ofLogError("AutoCalibration") << "calibration failed, the previous one is kept";
+        return;
+    }
+    leftPoints = warpedCorners;
+    rightPoints.clear();
+    for(int i = 0; i < cameraCorners.size(); i++) rightPoints.push_back(cameraCorners[i] + ofVec2f(camWidth, 0));
+    writeXMLPoints();
+    homography = solved;
+    homographyReady = true;
+    saveHomography();
+    
+    layout.save();
+    createGround();
+    drawProjectorBounds = true;
+    markProjectorBounds = false;
+    markingRegion = -1;
+}
+
+//the ground runs under all calibrated outputs, from the leftmost bottom-left
+//corner to the rightmost bottom-right corner
+void ofApp::createGround() {
+    const ProjectorRegion *left = NULL, *right = NULL;
+    for(int r=0; r<layout.regions.size(); r++) {
+        const ProjectorRegion &region = layout.regions[r];
+        if(!region.calibrated) continue;
+        if(!left || region.corners[3].x < left->corners[3].x) left = &region;
+        if(!right || region.corners[2].x > right->corners[2].x) right = &region;
     }
+    if(left) box2d.createGround(left->corners[3], right->corners[2]);
+    else box2d.createGround();
 }
 
 
@@ -818,6 +1971,120 @@ void ofApp::pushXMLPoint(ofVec2f point, int index, int LorR) {
     points.saveFile("points.xml");
 }
 
+//--------------------------------------------------------------
+//reopens the camera in another mode and rescales everything sized by it.
+//false when the camera refused the mode and was reopened in the old one
+bool ofApp::setCameraMode(int index) {
+    const CameraMode &mode = cameraModes[index];
+    if(mode.width == camWidth && mode.height == camHeight && mode.fps == camFrameRate) return true;
+    ofLogNotice("camera") << "switching to " << mode.name;
+    
+    //no frame of the old size may come out of the pipeline after this
+    pipeline.pause();
+    pipeline.flush();
+    //the texture may still point into the frame's pixels
+    warpedTexture.clear();
+    shownFrame.reset();
+    tracked.blobs.clear();
+    //a trace has a single camera size
+    if(traceWriter.isOpen()) toggleTraceRecording();
+    
+    vidGrabber.close();
+    vidGrabber.setDesiredFrameRate(mode.fps);
+    bool opened = vidGrabber.setup(mode.width, mode.height);
+    if(!opened) {
+        ofLogError("camera") << "couldn't open " << mode.name << ", back to " << camWidth << "x" << camHeight << " at " << camFrameRate << "fps";
+        vidGrabber.close();
+        vidGrabber.setDesiredFrameRate(camFrameRate);
+        if(!vidGrabber.setup(camWidth, camHeight)) ofLogError("camera") << "couldn't reopen the camera";
+    }
+    vidGrabber.setAutogain(false);
+    vidGrabber.setAutoWhiteBalance(false);
+    if(opened) {
+        int fromWidth = camWidth, fromHeight = camHeight;
+        camWidth = mode.width;
+        camHeight = mode.height;
+        camFrameRate = mode.fps;
+        
+        //calibrations keep pointing at the same places in the image
+        rescalePoints(fromWidth, fromHeight);
+        rescaleHomography(fromWidth, fromHeight);
+        writeXMLPoints();
+        if(ofFile("homography.yml").exists()) saveHomography();
+        for(int r=0; r<layout.regions.size(); r++) {
+            if(layout.regions[r].corners.size() == 4) layout.regions[r].calibrate(camWidth, camHeight);
+        }
+        
+        videoPix.allocate(camWidth, camHeight, OF_PIXELS_RGBA);
+        videoImg.allocate(camWidth, camHeight, OF_IMAGE_COLOR);
+        debugPos = ofPoint(10, camHeight+35);
+        governor.setup(camFrameRate);
+    }
+    
+    //the reopened camera needs its exposure, gain etc. again
+    cameraParams = ParamWatcher();
+    for(int i = 0; i < numCameraModes; i++) cameraParams.changed(params.get(paramId(cameraModes[i].name)));
+    pipeline.resume();
+    return opened;
+}
+
+//the camera points are in preview pixels, the right ones offset by the camera width
+void ofApp::rescalePoints(int fromWidth, int fromHeight) {
+    if(fromWidth == camWidth && fromHeight == camHeight) return;
+    float sx = (float)camWidth / fromWidth;
+    float sy = (float)camHeight / fromHeight;
+    for(int i = 0; i < leftPoints.size(); i++) {
+        leftPoints[i].set(leftPoints[i].x * sx, leftPoints[i].y * sy);
+    }
+    for(int i = 0; i < rightPoints.size(); i++) {
+        rightPoints[i].set((rightPoints[i].x - fromWidth) * sx + camWidth, rightPoints[i].y * sy);
+    }
+}
+
+//camera pixels -> warped pixels, both scale the same way: S * H * S^-1
+void ofApp::rescaleHomography(int fromWidth, int fromHeight) {
+    if(homography.empty() || (fromWidth == camWidth && fromHeight == camHeight)) return;
+    Mat scale = (Mat_<double>(3,3) << (double)camWidth / fromWidth, 0, 0,
+                                      0, (double)camHeight / fromHeight, 0,
+                                      0, 0, 1);
+    homography = scale * homography * scale.inv();
+}
+
+void ofApp::saveHomography() {
+    FileStorage fs(ofToDataPath("homography.yml"), FileStorage::WRITE);
+    fs << "homography" << homography;
+    fs << "width" << camWidth;
+    fs << "height" << camHeight;
+}
+
+//rewrites points.xml from the current points
+void ofApp::writeXMLPoints() {
+    points.clear();
+    points.addTag("leftPoints");
+    points.pushTag("leftPoints");
+    for(int i = 0; i < leftPoints.size(); i++) {
+        points.addTag("p");
+        points.pushTag("p",i);
+        points.addValue("x", leftPoints[i].x);
+        points.addValue("y", leftPoints[i].y);
+        points.popTag();
+    }
+    points.popTag();
+    points.addTag("rightPoints");
+    points.pushTag("rightPoints");
+    for(int i = 0; i < rightPoints.size(); i++) {
+        points.addTag("p");
+        points.pushTag("p",i);
+        points.addValue("x", rightPoints[i].x);
+        points.addValue("y", rightPoints[i].y);
+        points.popTag();
+    }
+    points.popTag();
+    points.setValue("camera:w", camWidth);
+    points.setValue("camera:h", camHeight);
+    points.saveFile("points.xml");
+}
+
 //creates the initial XML structure for points on click
 void ofApp::saveXMLPoints(ofVec2f cur) {
     
@@ -844,51 +2111,34 @@ void ofApp::saveXMLPoints(ofVec2f cur) {
     points.addValue("y", cur.y + rightOffset.y);
     points.popTag();
     points.popTag();
+    points.setValue("camera:w", camWidth);
+    points.setValue("camera:h", camHeight);
     points.saveFile("points.xml");
     
 }
 
-//saves the global coordinates of the projector points for next time
-void ofApp::saveProjectorPoint(ofVec2f cur, int index) {
-    
-    //left
-    if(!projXML.pushTag("Points")) {
-        projXML.addTag("Points");
-        projXML.pushTag("Points");
-    }
-    if(!projXML.pushTag("p",index)) {
-        projXML.addTag("p");
-        projXML.pushTag("p",index);
-        projXML.addValue("x", cur.x);
-        projXML.addValue("y", cur.y);
-    } else {
-        projXML.pushTag("p",index);
-        projXML.setValue("x", cur.x);
-        projXML.setValue("y", cur.y);
-    }
-    
-    projXML.popTag();
-    projXML.popTag();
-    projXML.saveFile("projectorPoints.xml");
-
-}
 
 
 
 //updates the value of the current point.
 void ofApp::mouseDragged(int x, int y, int button) {
+    pacer.markChanged();
     if(movingPoint && !lockHomography) {
         curPoint->set(x, y);
     }
 }
 
 void ofApp::mouseReleased(int x, int y, int button) {
+    pacer.markChanged();
     //pushes released point into XML file
     if(movingPoint && !lockHomography ) pushXMLPoint(ofVec2f(x,y),curPointIndex,curPointLeftOrRight);
     movingPoint = false;
 }
 
 void ofApp::keyPressed(int key) {
+    pacer.markChanged();
+    //keys start and stop what the status lines report, don't wait for the next refresh
+    statsText.expire();
     //save matrix settings
     if(key == 'g') {
         gui0->toggleVisible();
@@ -906,21 +2156,53 @@ void ofApp::keyPressed(int key) {
     }
     //box2D clear
     else if(key == 'c') {
-        shape.clear();
-        polyShapes.clear();
-        circles.clear();
+        physicsEvent(PHYSICS_CLEAR_CIRCLES);
     }
     //box2d create circles
     else if(key == '1') {
-        shared_ptr<ofxBox2dCircle> circle = shared_ptr<ofxBox2dCircle>(new ofxBox2dCircle);
-        circle.get()->setPhysics(0.3, 0.5, 0.1);
-        circle.get()->setup(box2d.getWorld(), mouseX, mouseY, ofRandom(10, 20));
-        circles.push_back(circle);
+        physicsEvent(TraceEvent(PHYSICS_DROP_CIRCLE, ofPoint(mouseX, mouseY)));
+    }
+    //start/stop recording a contour trace
+    else if(key == 'r') {
+        toggleTraceRecording();
+    }
+    //receive our own tracking output to check the publisher
+    else if(key == 'l') {
+        toggleLoopback();
+    }
+    //physics-only replay of the last recorded trace
+    else if(key == 'b') {
+        if(!tracePath.empty()) runReplayBenchmark(tracePath, replaySteps);
+    }
+    //both trackers on the contours of the last recorded trace
+    else if(key == 't') {
+        if(!tracePath.empty()) runTrackerBenchmark(tracePath);
+    }
+    //record the show, through ffmpeg or as raw frames
+    else if(key == 'v') {
+        toggleShowRecording(RECORD_FFMPEG);
+    }
+    else if(key == 'V') {
+        toggleShowRecording(RECORD_PPM);
+    }
+    //project gray codes on every output and calibrate from what the camera sees
+    else if(key == 'a') {
+        if(autoCalibration.isRunning()) autoCalibration.stop();
+        else autoCalibration.start(layout, camWidth, camHeight);
+    }
+    //the same decoding and solving on rendered frames with a known answer
+    else if(key == 'A') {
+        if(!autoCalibration.isRunning()) syntheticCheck.start(autoCalibration, layout, camWidth, camHeight);
+    }
+    //the next tracked frame's largest shadow goes into the puppet library
+    else if(key == 'k' || key == 'K') {
+        if(key == 'k' || teachingPuppet.empty()) teachingPuppet = ofGetTimestampString("puppet-%Y%m%d-%H%M%S");
+        pendingPuppet = teachingPuppet;
     }
     else if(key == 'p') {
+        //corners are cleared once the first click picks the output
         markProjectorBounds = true;
-        applyProjectorHomography = false;
-        projectorPoints.clear();
+        markingRegion = -1;
     }
 }
 
@@ -32,6 +32,27 @@
 #include "ofxUI.h"
 #include "ofxBox2d.h"
 #include "customParticle.h"
+#include "streamedTexture.h"
+#include "silhouetteCollider.h"
+#include "trackingFrame.h"
+#include "contourSimplifier.h"
+#include "qualityGovernor.h"
+#include "sceneSnapshot.h"
+#include "contourTrace.h"
+#include "paramRegistry.h"
+#include "trackingPublisher.h"
+#include "frameExporter.h"
+#include "projectorLayout.h"
+#include "activityLod.h"
+#include "framePipeline.h"
+#include "sdfParticles.h"
+#include "blobTracker.h"
+#include "runSegmenter.h"
+#include "autoCalibration.h"
+#include "framePacer.h"
+#include "showRecorder.h"
+#include "overlayCache.h"
+#include "puppetLibrary.h"
 
 class ofApp: public ofBaseApp
 {
@@ -41,6 +62,7 @@ public:
     void setup();
     void update();
     void draw();
+    void drawScene();
     void exit();
     void mousePressed(int x, int y, int button);
     void mouseDragged(int x, int y, int button);
@@ -49,10 +71,14 @@ public:
     
     //---------homography
     bool movePoint(vector<ofVec2f>& points, ofVec2f point, int LeftOrRight);
-    void drawPoints(vector<ofVec2f>& points);
+    void addPointMarks(ofMesh &mesh, const vector<ofVec2f>& points, const ofColor &color);
     void updateGUIPostions();
     void clearPoints();
     void saveXMLPoints(ofVec2f cur);
+    void writeXMLPoints();
+    void saveHomography();
+    void rescalePoints(int fromWidth, int fromHeight);
+    void rescaleHomography(int fromWidth, int fromHeight);
     void pushXMLPoint(ofVec2f point, int index, int LorR);
     
     //--------- ofxUI
@@ -65,11 +91,26 @@ public:
     ofxUISuperCanvas *gui2;
     ofxUISuperCanvas *gui3; 
     void guiEvent(ofxUIEventArgs &e);
+    
+    //--------- parameters, written by the gui and read by each stage
+    ParamRegistry params;
+    ParamWatcher cameraParams, trackingParams, visionParams, physicsParams;
+    void setupParams();
+    void applyCameraParams();
+    void applyTrackingParams();
+    void applyVisionParams(float pixelScale);
+    int pickRadio(ParamWatcher &watcher, const vector<ParamId> &options);
+    float visionScale;
+    void applyPhysicsParams();
     int frameCount;
     void refreshGUIs(); 
     
     //---------General Parameters
     bool                fullScreen;
+    QualityGovernor     governor;
+    float               workStart, workSeconds;     //work of every wake and the draw since the last present
+    void applyQuality(const QualityLevel &level);
+    void applyGovernedQuality();
     
     //----------PS3 Camera Control
     ofxPS3EyeGrabber vidGrabber;
@@ -77,15 +118,17 @@ public:
     int camWidth;
     int camHeight;
     int camFrameRate;
+    bool setCameraMode(int index);
     ofPixels		 	videoPix;
     ofImage             videoImg;
-    ofTexture			videoTexture;
-    ofTexture           warpedTexture;
+    StreamedTexture     videoTexture;
+    StreamedTexture     warpedTexture;
+    FrameExporter       frameExporter;
+    unsigned long long  cameraFrameNumber;
     
     //------------Homography
     float sX, sY, ratio;
     ofPoint debugPos; 
-    ofImage warpedColor;
     vector<ofVec2f> leftPoints, rightPoints;
     bool movingPoint, mirrorLeft, mirrorRight;
     ofVec2f* curPoint;
@@ -93,40 +136,128 @@ public:
     bool saveMatrix;
     bool homographyReady, lockHomography;
     ofxXmlSettings points;
-    ofxXmlSettings projXML; 
     cv::Mat homography;
     
     //------------Tracking
     void drawTracker(); 
+    void collectBlobs(TrackingFrame &frame);
+    void findBlobs(PipelineFrame &frame);
+    void collectRuns(PipelineFrame &frame, bool track);
+    void updateTrackingMask(PipelineFrame &frame);
+    void updateDistanceField(PipelineFrame &frame);
     ofxCv::ContourFinder contourFinder;
+    TrackingFrame tracked;
+    ContourSimplifier simplifier;
+    BlobTracker blobTracker;
+    RunSegmenter segmenter;
+    
+    //-------------Puppet recognition, the library belongs to the track stage
+    void teachPuppet(PipelineFrame &frame);
+    void triggerPuppets();
+    PuppetLibrary puppets;
+    string puppetPath, teachingPuppet, pendingPuppet;
+    map<int, string> shownPuppets;
+    int puppetTemplates, puppetLookups;
+    float puppetMs;
+    unsigned long long frameCaptureMicros;
+    int vertexBudget, contourVertices;
+    
+    //-------------Frame pipeline, capture -> warp -> track -> physics
+    void warpFrame(PipelineFrame &frame);
+    void trackFrame(PipelineFrame &frame);
+    FramePipeline pipeline;
+    PipelineFramePtr shownFrame;
+    
+    //-------------Frame pacing, the loop wakes for camera frames, physics steps and redraws
+    FramePacer pacer;
+    void updateWake();      //everything one wake of the loop does
+    
+    //-------------Overlay, rebuilt only when what it shows changes
+    void updateOverlay();
+    void drawOverlay();
+    RetainedText statsText, directionsText;
+    RetainedMesh wallMesh, projectorMesh, pointMesh;
+    
+    //-------------Tracking output
+    struct LoopbackStats {
+        LoopbackStats() : frames(0), gaps(0), lastSequence(0), blobs(0), latencyMs(0) {}
+        unsigned long long frames, gaps, lastSequence;
+        int blobs;
+        float latencyMs;
+    };
+    void toggleLoopback();
+    void checkLoopback();
+    TrackingPublisher publisher;
+    TrackingReceiver loopback;
+    LoopbackStats loopbackUdp, loopbackShm;
+    bool loopbackActive;
+    string publishHost, publishShmName;
+    int publishPort;
     float threshold;
-    bool showTracker;
+    int blurSize;
     
     //-------------Projector Space
-    float projectorWidth, projectorHeight;
-    float displayWidth; 
-    vector<ofPoint> projectorPoints;
-    bool  markProjectorBounds, drawProjectorBounds, applyProjectorHomography;
-    void drawProjectorRect();
-    cv::Mat projectorHomography;
-    ofImage projectorWarp; 
+    ProjectorLayout layout;
+    int   markingRegion;
+    bool  markProjectorBounds, drawProjectorBounds;
+    void drawRegion(const ProjectorRegion &region);
+    int drawnBodies;
+    AutoCalibration autoCalibration;
+    SyntheticCheck syntheticCheck;
+    StreamedTexture patternTexture;
+    int patternVersion;
+    void drawCalibrationPattern();
+    void finishAutoCalibration();
     
     //-------------Box2d
-    float xOffset; 
     ofxBox2d                                box2d;
     vector <shared_ptr<ofxBox2dCircle > >   circles;
     vector <shared_ptr<ofxBox2dPolygon> >	polyShapes;
     vector <shared_ptr<ofxBox2dRect   > >	walls;
     vector <shared_ptr<CustomParticle > >   customParticles;
     ofPolyline                              shape;
-    void updateBox2DForces(cv::Point2f centroid);
+    void updateBox2DForces();
+    ActivityLod                             activity;
+    SdfParticleSystem                       sdfParticles;
+    int                                     sdfCount;
+    float                                   sdfTime;       //when the sdf particles last stepped
+    void updateSdfParticles(const PipelineFramePtr &frame);
+    ofVec2f windowToCamera(const ofVec2f &dir);
     void createBox2DShape(ofPolyline &daShape);
+    void createSilhouettes(float seconds);   //seconds simulated since the previous silhouettes
+    float silhouetteSeconds;
+    bool silhouettesStale;      //a tracked frame came in since the silhouettes were built
+    SilhouetteColliders                     silhouettes;
     vector<ofPoint> scalePolyShape(ofPolyline shapeIn);
     bool gravityOn, wallsOn;
     float circleMin, circleMax, circleFreq;
+    int maxParticles;
+    void trimParticles();
     void addWalls();
-    void saveProjectorPoint(ofVec2f cur, int index);
-    void writeProjectorPoints(); 
+    void writeProjectorPoints(int index);
+    void createGround();
+    
+    //-------------Scene snapshots
+    void captureScene(SceneSnapshot &snapshot);
+    void restoreSceneBodies(const SceneSnapshot &snapshot);
+    void restoreSceneParams(const SceneSnapshot &snapshot);
+    SnapshotWriter  snapshotWriter;
+    SceneSnapshot   restoredScene;
+    bool            sceneRestored;
+    float           snapshotInterval, lastSnapshotTime;
+    
+    //-------------Trace record/replay
+    void physicsEvent(const TraceEvent &event);
+    void toggleTraceRecording();
+    void runReplayBenchmark(const string &path, int steps);
+    void runTrackerBenchmark(const string &path);
+    ContourTraceWriter  traceWriter;
+    string              tracePath;
+    int                 replaySteps;
+    
+    //-------------Show recording of the projector outputs
+    void toggleShowRecording(RecorderOutput output);
+    ShowRecorder        showRecorder;
     
 
 };
@@ -0,0 +1,69 @@
+//
+//  overlayCache.cpp
+//  PS3_Homography
+//
+
+#include "overlayCache.h"
+
+//bitmap font cells are 8x13, the box around them like ofDrawBitmapStringHighlight
+static const int textPadding = 4;
+
+OverlayKey& OverlayKey::add(const void *data, size_t bytes) {
+    const unsigned char *p = (const unsigned char*)data;
+    for(size_t i=0; i<bytes; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return *this;
+}
+
+void RetainedMesh::setKey(const OverlayKey &inputs) {
+    key = inputs.get();
+    built = true;
+}
+
+void RetainedMesh::draw() const {
+    if(mesh.getNumVertices() == 0) return;
+    mesh.draw();
+}
+
+RetainedText::RetainedText() {
+    interval = 0;
+    lastRefresh = -1;
+}
+
+bool RetainedText::isDue() const {
+    if(lastRefresh < 0) return true;
+    return interval > 0 && ofGetElapsedTimef() - lastRefresh >= interval;
+}
+
+void RetainedText::setText(const string &_text) {
+    lastRefresh = ofGetElapsedTimef();
+    if(_text == text && fbo.isAllocated()) return;
+    text = _text;
+
+    ofBitmapFont font;
+    ofRectangle box = font.getBoundingBox(text, 0, 0);
+    int w = MAX(1, (int)ceil(box.width) + textPadding * 2);
+    int h = MAX(1, (int)ceil(box.height) + textPadding * 2);
+    if(!fbo.isAllocated() || fbo.getWidth() != w || fbo.getHeight() != h) {
+        fbo.allocate(w, h, GL_RGBA);
+    }
+
+    fbo.begin();
+    ofClear(0, 0, 0, 255);
+    ofPushStyle();
+    ofSetColor(255);
+    ofDrawBitmapString(text, textPadding - box.x, textPadding - box.y);
+    ofPopStyle();
+    fbo.end();
+}
+
+void RetainedText::draw(float x, float y) const {
+    if(!fbo.isAllocated()) return;
+    ofPushStyle();
+    ofSetColor(255);
+    //placed where ofDrawBitmapStringHighlight would put the box for text drawn at x, y
+    fbo.draw(x - textPadding, y - 13 - textPadding + 3);
+    ofPopStyle();
+}
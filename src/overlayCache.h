@@ -0,0 +1,71 @@
+//
+//  overlayCache.h
+//  PS3_Homography
+//
+//  Retained pieces of the operator overlay. Geometry that hardly ever
+//  changes (walls, projector outlines, calibration points) is kept in a
+//  vbo mesh and text in an fbo, and each piece is only rebuilt when the
+//  key of its inputs changes. Text can also be throttled to a fixed
+//  refresh rate, so live stats are formatted a few times per second
+//  instead of every frame.
+//
+
+#ifndef PS3_Homography_overlayCache_h
+#define PS3_Homography_overlayCache_h
+
+#include "ofMain.h"
+
+//FNV-1a over the values a cached piece is built from
+class OverlayKey {
+
+public:
+    OverlayKey() : hash(1469598103934665603ull) {}
+    OverlayKey& add(const void *data, size_t bytes);
+    OverlayKey& add(float value) { return add(&value, sizeof(value)); }
+    OverlayKey& add(int value) { return add(&value, sizeof(value)); }
+    OverlayKey& add(const ofVec2f &p) { return add(p.x).add(p.y); }
+    uint64_t get() const { return hash; }
+
+private:
+    uint64_t hash;
+};
+
+class RetainedMesh {
+
+public:
+    RetainedMesh() : key(0), built(false) {}
+
+    //true when the mesh was built from other inputs, the caller rebuilds it then calls setKey
+    bool isStale(const OverlayKey &inputs) const { return !built || inputs.get() != key; }
+    void setKey(const OverlayKey &inputs);
+    void draw() const;
+
+    ofVboMesh mesh;
+
+private:
+    uint64_t key;
+    bool     built;
+};
+
+class RetainedText {
+
+public:
+    RetainedText();
+
+    //true when the text should be formatted again: never set, expired or interval passed
+    bool isDue() const;
+    void expire() { lastRefresh = -1; }
+    //draws the text into the fbo if it differs from what is there
+    void setText(const string &text);
+    void draw(float x, float y) const;
+    float getHeight() const { return fbo.getHeight(); }
+
+    float interval;     //seconds between refreshes, 0 for text that only changes on expire
+
+private:
+    string  text;
+    ofFbo   fbo;
+    float   lastRefresh;
+};
+
+#endif
@@ -0,0 +1,97 @@
+//
+//  paramRegistry.cpp
+//  PS3_Homography
+//
+
+#include "paramRegistry.h"
+
+Param::Param(const string &_name, ParamType _type, float _value)
+: id(paramId(_name.c_str())), name(_name), type(_type), value(_value), version(0), pending(0) {
+}
+
+bool Param::poll(unsigned int &seen) const {
+    unsigned int current = version.load(std::memory_order_acquire);
+    if(current == seen) return false;
+    seen = current;
+    return true;
+}
+
+//--------------------------------------------------------------
+ParamRegistry::ParamRegistry() : generation(0), sealed(false) {
+}
+
+ParamRegistry::~ParamRegistry() {
+    for(map<ParamId, Param*>::iterator it = params.begin(); it != params.end(); ++it) {
+        delete it->second;
+    }
+}
+
+Param& ParamRegistry::addBool(const string &name, bool value) {
+    return add(name, PARAM_BOOL, value ? 1 : 0);
+}
+
+Param& ParamRegistry::addFloat(const string &name, float value) {
+    return add(name, PARAM_FLOAT, value);
+}
+
+Param& ParamRegistry::addTrigger(const string &name) {
+    return add(name, PARAM_TRIGGER, 0);
+}
+
+Param& ParamRegistry::add(const string &name, ParamType type, float value) {
+    if(sealed) ofLogError("ParamRegistry") << "'" << name << "' registered after seal()";
+    Param *param = new Param(name, type, value);
+    map<ParamId, Param*>::iterator it = params.find(param->id);
+    if(it != params.end()) {
+        ofLogError("ParamRegistry") << "'" << name << "' collides with '" << it->second->name << "'";
+        delete param;
+        return *it->second;
+    }
+    params[param->id] = param;
+    return *param;
+}
+
+Param* ParamRegistry::find(ParamId id) const {
+    map<ParamId, Param*>::const_iterator it = params.find(id);
+    return it == params.end() ? NULL : it->second;
+}
+
+Param& ParamRegistry::get(ParamId id) const {
+    return *params.find(id)->second;
+}
+
+bool ParamRegistry::set(ParamId id, float value) {
+    Param *param = find(id);
+    if(param == NULL) return false;
+    if(param->type == PARAM_TRIGGER) {
+        //buttons report press and release, only the press counts
+        if(value == 0) return true;
+        param->pending++;
+    } else {
+        param->value.store(value, std::memory_order_release);
+    }
+    param->version++;
+    generation++;
+    if(param->onChange) param->onChange(value);
+    return true;
+}
+
+bool ParamRegistry::set(ofxUIWidget *widget) {
+    float value;
+    switch(widget->getKind()) {
+        case OFX_UI_WIDGET_SLIDER_H:
+        case OFX_UI_WIDGET_SLIDER_V:
+        case OFX_UI_WIDGET_MINIMALSLIDER:
+            value = ((ofxUISlider *) widget)->getValue();
+            break;
+        case OFX_UI_WIDGET_BUTTON:
+        case OFX_UI_WIDGET_LABELBUTTON:
+        case OFX_UI_WIDGET_TOGGLE:
+        case OFX_UI_WIDGET_LABELTOGGLE:
+            value = ((ofxUIButton *) widget)->getValue() ? 1 : 0;
+            break;
+        default:
+            return false;
+    }
+    return set(paramId(widget->getName().c_str()), value);
+}
@@ -0,0 +1,112 @@
+//
+//  paramRegistry.h
+//  PS3_Homography
+//
+//  Typed parameters registered once at setup and looked up by a hash of
+//  their name. Values are atomics, so the capture, tracking and physics
+//  stages can read them without locks while the gui thread writes them.
+//  Every write bumps a per-parameter version that readers poll to find out
+//  what changed; triggers count presses until the owning stage consumes them.
+//
+
+#ifndef PS3_Homography_paramRegistry_h
+#define PS3_Homography_paramRegistry_h
+
+#include "ofMain.h"
+#include "ofxUI.h"
+#include <atomic>
+#include <stdint.h>
+
+typedef uint32_t ParamId;
+
+//fnv-1a, usable at compile time so ids can be constants
+constexpr ParamId paramId(const char *name, uint32_t hash = 2166136261u) {
+    return *name ? paramId(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+enum ParamType {
+    PARAM_BOOL,
+    PARAM_FLOAT,
+    PARAM_TRIGGER
+};
+
+class Param {
+    
+public:
+    Param(const string &name, ParamType type, float value);
+    
+    float get() const { return value.load(std::memory_order_acquire); }
+    bool getBool() const { return get() != 0; }
+    
+    //true if the value changed since the version in seen, which is then updated
+    bool poll(unsigned int &seen) const;
+    
+    //number of presses since the last call, for PARAM_TRIGGER
+    int consume() { return pending.exchange(0); }
+    
+    const ParamId    id;
+    const string     name;
+    const ParamType  type;
+    
+    //called on the thread that set the value, for gui-side work like saving settings
+    std::function<void(float)> onChange;
+    
+private:
+    friend class ParamRegistry;
+    std::atomic<float>         value;
+    std::atomic<unsigned int>  version;
+    std::atomic<int>           pending;
+};
+
+//per-stage record of the versions it has already applied; owned by one thread
+class ParamWatcher {
+    
+public:
+    //true the first time a parameter is seen and after every write to it
+    bool changed(const Param &param) {
+        map<ParamId, unsigned int>::iterator it = seen.find(param.id);
+        if(it == seen.end()) {
+            param.poll(seen[param.id]);
+            return true;
+        }
+        return param.poll(it->second);
+    }
+    
+private:
+    map<ParamId, unsigned int> seen;
+};
+
+class ParamRegistry {
+    
+public:
+    ParamRegistry();
+    ~ParamRegistry();
+    
+    Param& addBool(const string &name, bool value);
+    Param& addFloat(const string &name, float value);
+    Param& addTrigger(const string &name);
+    
+    //no registration after this, lookups from other threads are then safe
+    void seal() { sealed = true; }
+    
+    Param* find(ParamId id) const;
+    Param& get(ParamId id) const;       //id must be registered
+    
+    bool set(ParamId id, float value);
+    bool set(const string &name, float value) { return set(paramId(name.c_str()), value); }
+    
+    //ofxUI binding: applies a widget event (including those fired by loadSettings)
+    bool set(ofxUIWidget *widget);
+    
+    //bumped on every write to any parameter
+    unsigned int getGeneration() const { return generation.load(std::memory_order_acquire); }
+    
+private:
+    Param& add(const string &name, ParamType type, float value);
+    
+    map<ParamId, Param*>       params;
+    std::atomic<unsigned int>  generation;
+    bool                       sealed;
+};
+
+#endif
@@ -0,0 +1,190 @@
+//
+//  projectorLayout.cpp
+//  PS3_Homography
+//
+
+#include "projectorLayout.h"
+#include "ofxXmlSettings.h"
+
+using namespace cv;
+
+ProjectorRegion::ProjectorRegion() {
+    viewport.set(1440, 0, 1024, 768);
+    cameraArea.set(0, 0, 1, 1);
+    calibrated = false;
+}
+
+bool ProjectorRegion::calibrate(int camWidth, int camHeight) {
+    calibrated = false;
+    if(corners.size() < 4) return false;
+    
+    vector<Point2f> srcPoints, dstPoints;
+    float x0 = cameraArea.x * camWidth, x1 = (cameraArea.x + cameraArea.width) * camWidth;
+    float y0 = cameraArea.y * camHeight, y1 = (cameraArea.y + cameraArea.height) * camHeight;
+    srcPoints.push_back(Point2f(x0, y0));
+    srcPoints.push_back(Point2f(x1, y0));
+    srcPoints.push_back(Point2f(x1, y1));
+    srcPoints.push_back(Point2f(x0, y1));
+    for(int i=0; i<4; i++) {
+        //shift into the viewport and scale to camera size
+        dstPoints.push_back(Point2f((corners[i].x - viewport.x) * camWidth / viewport.width,
+                                    (corners[i].y - viewport.y) * camHeight / viewport.height));
+    }
+    homography = findHomography(Mat(srcPoints), Mat(dstPoints));
+    calibrated = !homography.empty();
+    return calibrated;
+}
+
+ofPoint ProjectorRegion::cameraToWindow(const ofPoint &p, int camWidth, int camHeight) const {
+    vector<ofPoint> pts(1, p);
+    cameraToWindow(pts, camWidth, camHeight);
+    return pts[0];
+}
+
+void ProjectorRegion::cameraToWindow(vector<ofPoint> &pts, int camWidth, int camHeight) const {
+    if(pts.empty() || !calibrated) return;
+    vector<Point2f> in(pts.size()), out(pts.size());
+    for(int i=0; i<pts.size(); i++) in[i] = Point2f(pts[i].x, pts[i].y);
+    perspectiveTransform(in, out, homography);
+    float xScale = viewport.width / camWidth;
+    float yScale = viewport.height / camHeight;
+    for(int i=0; i<pts.size(); i++) {
+        pts[i].x = out[i].x * xScale + viewport.x;
+        pts[i].y = out[i].y * yScale + viewport.y;
+    }
+}
+
+ofMatrix4x4 ProjectorRegion::getCameraToWindowMatrix(int camWidth, int camHeight) const {
+    if(!calibrated) return ofMatrix4x4();
+    //the homography goes in the x, y and w columns, GL does the perspective divide
+    const double *h = homography.ptr<double>();
+    ofMatrix4x4 m(h[0], h[3], 0, h[6],
+                  h[1], h[4], 0, h[7],
+                  0,    0,    1, 0,
+                  h[2], h[5], 0, h[8]);
+    m *= ofMatrix4x4::newScaleMatrix(viewport.width / camWidth, viewport.height / camHeight, 1);
+    m *= ofMatrix4x4::newTranslationMatrix(viewport.x, viewport.y, 0);
+    return m;
+}
+
+bool ProjectorRegion::coversCamera(const ofPoint &p, int camWidth, int camHeight) const {
+    return cameraArea.inside(p.x / camWidth, p.y / camHeight);
+}
+
+//--------------------------------------------------------------
+ProjectorLayout::ProjectorLayout() {
+    displayWidth = 1440;
+    windowWidth = 0;
+}
+
+bool ProjectorLayout::load() {
+    regions.clear();
+    ofxXmlSettings xml;
+    if(xml.loadFile("projectors.xml")) {
+        displayWidth = xml.getValue("display", displayWidth);
+        windowWidth = xml.getValue("window", 0);
+        for(int r=0; r<xml.getNumTags("projector"); r++) {
+            xml.pushTag("projector", r);
+            ProjectorRegion region;
+            region.name = xml.getValue("name", "projector " + ofToString(r));
+            region.viewport.set(xml.getValue("viewport:x", displayWidth), xml.getValue("viewport:y", 0.0),
+                                xml.getValue("viewport:w", 1024.0), xml.getValue("viewport:h", 768.0));
+            region.cameraArea.set(xml.getValue("camera:x", 0.0), xml.getValue("camera:y", 0.0),
+                                  xml.getValue("camera:w", 1.0), xml.getValue("camera:h", 1.0));
+            if(xml.pushTag("Points")) {
+                for(int i=0; i<xml.getNumTags("p"); i++) {
+                    region.corners.push_back(ofPoint(xml.getValue("p:x", 0.0, i), xml.getValue("p:y", 0.0, i)));
+                }
+                xml.popTag();
+            }
+            regions.push_back(region);
+            xml.popTag();
+        }
+    }
+    if(!regions.empty()) return true;
+    
+    //single projector, corners from the original projectorPoints.xml
+    ProjectorRegion region;
+    region.name = "projector 0";
+    region.viewport.x = displayWidth;
+    ofxXmlSettings legacy;
+    if(legacy.loadFile("projectorPoints.xml") && legacy.pushTag("Points")) {
+        for(int i=0; i<legacy.getNumTags("p") && i<4; i++) {
+            region.corners.push_back(ofPoint(legacy.getValue("p:x", 0.0, i), legacy.getValue("p:y", 0.0, i)));
+        }
+        legacy.popTag();
+    }
+    regions.push_back(region);
+    return false;
+}
+
+void ProjectorLayout::save() {
+    ofxXmlSettings xml;
+    xml.setValue("display", displayWidth);
+    if(windowWidth > 0) xml.setValue("window", windowWidth);
+    for(int r=0; r<regions.size(); r++) {
+        const ProjectorRegion &region = regions[r];
+        xml.addTag("projector");
+        xml.pushTag("projector", r);
+        xml.setValue("name", region.name);
+        xml.setValue("viewport:x", region.viewport.x);
+        xml.setValue("viewport:y", region.viewport.y);
+        xml.setValue("viewport:w", region.viewport.width);
+        xml.setValue("viewport:h", region.viewport.height);
+        xml.setValue("camera:x", region.cameraArea.x);
+        xml.setValue("camera:y", region.cameraArea.y);
+        xml.setValue("camera:w", region.cameraArea.width);
+        xml.setValue("camera:h", region.cameraArea.height);
+        xml.addTag("Points");
+        xml.pushTag("Points");
+        for(int i=0; i<region.corners.size(); i++) {
+            xml.addTag("p");
+            xml.setValue("p:x", region.corners[i].x, i);
+            xml.setValue("p:y", region.corners[i].y, i);
+        }
+        xml.popTag();
+        xml.popTag();
+    }
+    xml.saveFile("projectors.xml");
+}
+
+//the operator display is retina, so it takes twice its point width in the window
+int ProjectorLayout::getWindowWidth() const {
+    if(windowWidth > 0) return windowWidth;
+    return displayWidth * 2 + getOutputBounds().width;
+}
+
+int ProjectorLayout::getWindowHeight() const {
+    return MAX(768.0f, getOutputBounds().getBottom());
+}
+
+ofRectangle ProjectorLayout::getOutputBounds() const {
+    if(regions.empty()) return ofRectangle(displayWidth, 0, 0, 0);
+    ofRectangle bounds = regions[0].viewport;
+    for(int r=1; r<regions.size(); r++) bounds.growToInclude(regions[r].viewport);
+    return bounds;
+}
+
+bool ProjectorLayout::isCalibrated() const {
+    for(int r=0; r<regions.size(); r++) {
+        if(regions[r].calibrated) return true;
+    }
+    return false;
+}
+
+int ProjectorLayout::regionAt(float x, float y) const {
+    for(int r=0; r<regions.size(); r++) {
+        if(regions[r].viewport.inside(x, y)) return r;
+    }
+    return -1;
+}
+
+int ProjectorLayout::regionForCamera(const ofPoint &p, int camWidth, int camHeight) const {
+    int fallback = -1;
+    for(int r=0; r<regions.size(); r++) {
+        if(!regions[r].calibrated) continue;
+        if(regions[r].coversCamera(p, camWidth, camHeight)) return r;
+        if(fallback < 0) fallback = r;
+    }
+    return fallback;
+}
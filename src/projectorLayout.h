@@ -0,0 +1,65 @@
+//
+//  projectorLayout.h
+//  PS3_Homography
+//
+//  Any number of projector outputs laid out to the right of the operator
+//  display. Each output has its own viewport in the window, the part of
+//  the (warped) camera image it covers, its four clicked corners and the
+//  homography built from them. Stored in projectors.xml; without that file
+//  the single 1024x768 projector and the old projectorPoints.xml are used.
+//
+
+#ifndef PS3_Homography_projectorLayout_h
+#define PS3_Homography_projectorLayout_h
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+class ProjectorRegion {
+    
+public:
+    ProjectorRegion();
+    
+    //builds the homography from the four corners, camera pixels -> projector
+    //pixels scaled down to camera size (the scale projectorWarp previews in)
+    bool calibrate(int camWidth, int camHeight);
+    
+    //camera pixel -> window coordinates through this projector
+    ofPoint cameraToWindow(const ofPoint &p, int camWidth, int camHeight) const;
+    void cameraToWindow(vector<ofPoint> &pts, int camWidth, int camHeight) const;
+    
+    bool coversCamera(const ofPoint &p, int camWidth, int camHeight) const;
+    //the same mapping as a GL matrix, for drawing straight from camera coordinates
+    ofMatrix4x4 getCameraToWindowMatrix(int camWidth, int camHeight) const;
+    
+    string           name;
+    ofRectangle      viewport;      //output area in window coordinates
+    ofRectangle      cameraArea;    //part of the camera image shown here, normalized 0-1
+    vector<ofPoint>  corners;       //clicked corners in window coordinates: tl, tr, br, bl
+    cv::Mat          homography;
+    bool             calibrated;
+};
+
+class ProjectorLayout {
+    
+public:
+    ProjectorLayout();
+    
+    bool load();
+    void save();
+    
+    int getWindowWidth() const;
+    int getWindowHeight() const;
+    ofRectangle getOutputBounds() const;     //union of all viewports
+    
+    bool isCalibrated() const;
+    int regionAt(float x, float y) const;    //window coordinates, -1 if none
+    //calibrated region whose camera area holds p, -1 if nothing is calibrated
+    int regionForCamera(const ofPoint &p, int camWidth, int camHeight) const;
+    
+    float                    displayWidth;  //operator display left of the outputs
+    float                    windowWidth;   //0 = computed from the outputs
+    vector<ProjectorRegion>  regions;
+};
+
+#endif
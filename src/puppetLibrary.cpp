@@ -0,0 +1,266 @@
+//
+//  puppetLibrary.cpp
+//  PS3_Homography
+//
+
+#include "puppetLibrary.h"
+#include "ofxCv.h"
+#include <fstream>
+#include <sstream>
+
+//points the outline is resampled to before the Fourier transform
+static const int fourierSamples = 64;
+//log Hu moments span very different ranges, the higher ones are mostly noise on near
+//symmetric shapes. weighted so both halves of the descriptor count about the same
+static const float huWeights[PuppetLibrary::huCount] = {1, 0.5, 0.1, 0.1, 0.05, 0.05, 0.05};
+static const float fourierWeight = 4;
+//moments below this are treated as zero
+static const double huFloor = 1e-12;
+
+PuppetLibrary::PuppetLibrary() {
+    maxDistance = 1;
+    shapeTolerance = 0.05;
+    maxPerFrame = 8;
+    root = -1;
+    frame = 0;
+    lookups = 0;
+    lookupMs = 0;
+}
+
+bool PuppetLibrary::load(const string &path) {
+    std::ifstream in(ofToDataPath(path, true).c_str());
+    if(!in) return false;
+    templates.clear();
+    string line;
+    int lineNumber = 0;
+    while(std::getline(in, line)) {
+        lineNumber++;
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        PuppetTemplate item;
+        fields >> item.name;
+        float value;
+        while(fields >> value) item.descriptor.push_back(value);
+        if(item.name.empty()) continue;
+        if(item.descriptor.size() != descriptorSize) {
+            ofLogWarning("PuppetLibrary") << path << ":" << lineNumber << " has " << item.descriptor.size()
+                << " values instead of " << descriptorSize << ", skipped";
+            continue;
+        }
+        templates.push_back(item);
+    }
+    buildIndex();
+    ofLogNotice("PuppetLibrary") << "loaded " << templates.size() << " templates from " << path;
+    return true;
+}
+
+bool PuppetLibrary::save(const string &path) const {
+    std::ofstream out(ofToDataPath(path, true).c_str(), std::ios::trunc);
+    if(!out) {
+        ofLogError("PuppetLibrary") << "couldn't open " << path;
+        return false;
+    }
+    out << "# puppet templates: name, " << huCount << " log hu moments, " << fourierCount << " fourier magnitudes\n";
+    for(int i=0; i<templates.size(); i++) {
+        out << templates[i].name;
+        for(int d=0; d<descriptorSize; d++) out << " " << templates[i].descriptor[d];
+        out << "\n";
+    }
+    return (bool)out;
+}
+
+bool PuppetLibrary::addTemplate(const string &name, const ofPolyline &outline) {
+    PuppetTemplate item;
+    item.name = name;
+    if(!describe(outline, item.descriptor)) return false;
+    templates.push_back(item);
+    buildIndex();
+    return true;
+}
+
+void PuppetLibrary::reset() {
+    matches.clear();
+}
+
+bool PuppetLibrary::describe(const ofPolyline &outline, vector<float> &descriptor) {
+    const vector<ofPoint> &points = outline.getVertices();
+    int n = points.size();
+    if(n < 8) return false;
+
+    //hu moments of the filled outline
+    vector<cv::Point2f> contour(n);
+    for(int i=0; i<n; i++) contour[i] = cv::Point2f(points[i].x, points[i].y);
+    double hu[huCount];
+    cv::HuMoments(cv::moments(contour), hu);
+
+    //arc length resampling, counter clockwise so the coefficients don't swap sides
+    vector<float> length(n + 1, 0);
+    for(int i=0; i<n; i++) length[i+1] = length[i] + points[i].distance(points[(i + 1) % n]);
+    float perimeter = length[n];
+    if(perimeter < 1) return false;
+    double signedArea = 0;
+    for(int i=0; i<n; i++) {
+        const ofPoint &a = points[i], &b = points[(i + 1) % n];
+        signedArea += a.x * b.y - b.x * a.y;
+    }
+    vector<ofVec2f> samples(fourierSamples);
+    ofVec2f centroid(0, 0);
+    for(int s=0, seg=0; s<fourierSamples; s++) {
+        float at = perimeter * s / fourierSamples;
+        while(seg < n - 1 && length[seg+1] < at) seg++;
+        float span = length[seg+1] - length[seg];
+        float t = span > 0 ? (at - length[seg]) / span : 0;
+        ofVec2f p = points[seg].getInterpolated(points[(seg + 1) % n], t);
+        samples[signedArea < 0 ? (fourierSamples - s) % fourierSamples : s] = p;
+        centroid += p;
+    }
+    centroid /= fourierSamples;
+
+    //coefficients -6..-1 and 2..7, divided by the first one. 0 is the position, 1 the size
+    float magnitude[fourierCount + 1];
+    int k = -fourierCount / 2;
+    for(int c=0; c<=fourierCount; c++, k++) {
+        if(k == 0) k = 1;
+        double re = 0, im = 0;
+        for(int s=0; s<fourierSamples; s++) {
+            ofVec2f z = samples[s] - centroid;
+            double angle = -TWO_PI * k * s / fourierSamples;
+            double cs = cos(angle), sn = sin(angle);
+            re += z.x * cs - z.y * sn;
+            im += z.x * sn + z.y * cs;
+        }
+        magnitude[c] = sqrt(re * re + im * im);
+    }
+    float first = magnitude[fourierCount / 2];
+    if(first < 1e-6) return false;
+
+    descriptor.resize(descriptorSize);
+    for(int i=0; i<huCount; i++) descriptor[i] = log10(MAX(fabs(hu[i]), huFloor)) * huWeights[i];
+    for(int c=0, d=huCount; c<=fourierCount; c++) {
+        if(c == fourierCount / 2) continue;
+        descriptor[d++] = magnitude[c] / first * fourierWeight;
+    }
+    return true;
+}
+
+void PuppetLibrary::recognize(vector<TrackedBlob> &blobs, const std::function<void(int, ofPolyline&)> &outline) {
+    unsigned long long start = ofGetElapsedTimeMicros();
+    frame++;
+    lookups = 0;
+    for(int i=0; i<blobs.size(); i++) {
+        TrackedBlob &blob = blobs[i];
+        Match &match = matches[blob.label];
+        if(match.frame == 0) {
+            match.label = blob.label;
+            match.area = match.perimeter = 0;
+            match.item = -1;
+            match.distance = 0;
+        }
+        match.frame = frame;
+        bool changed = match.area <= 0 || match.perimeter <= 0
+            || fabs(blob.area / match.area - 1) > shapeTolerance
+            || fabs(blob.perimeter / match.perimeter - 1) > shapeTolerance;
+        if(changed && lookups < maxPerFrame && root >= 0) {
+            lookups++;
+            const ofPolyline *shape = &blob.contour;
+            if(shape->size() < 3 && outline) {
+                outline(i, traced);
+                shape = &traced;
+            }
+            match.area = blob.area;
+            match.perimeter = blob.perimeter;
+            match.item = -1;
+            match.distance = 0;
+            if(describe(*shape, query)) {
+                float found = maxDistance;
+                match.item = nearest(query, found);
+                match.distance = found;
+            }
+        }
+        if(match.item >= 0) {
+            blob.puppet = templates[match.item].name;
+            blob.puppetDistance = match.distance;
+        } else {
+            blob.puppet.clear();
+            blob.puppetDistance = 0;
+        }
+    }
+
+    //labels that are gone
+    for(std::unordered_map<int, Match>::iterator it = matches.begin(); it != matches.end(); ) {
+        if(it->second.frame != frame) it = matches.erase(it);
+        else ++it;
+    }
+    lookupMs = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+}
+
+float PuppetLibrary::distance(const float *a, const float *b) {
+    float sum = 0;
+    for(int d=0; d<descriptorSize; d++) {
+        float diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sqrt(sum);
+}
+
+//vantage point tree over every template, cached results point at templates so they go too
+void PuppetLibrary::buildIndex() {
+    nodes.clear();
+    nodes.reserve(templates.size());
+    vector<int> items(templates.size());
+    for(int i=0; i<items.size(); i++) items[i] = i;
+    root = buildNode(items, 0, items.size());
+    matches.clear();
+}
+
+int PuppetLibrary::buildNode(vector<int> &items, int begin, int end) {
+    if(begin >= end) return -1;
+    //the middle item as vantage point, the library order has no meaning
+    std::swap(items[begin], items[(begin + end) / 2]);
+    int index = nodes.size();
+    Node node;
+    node.item = items[begin];
+    node.radius = 0;
+    node.inside = node.outside = -1;
+    nodes.push_back(node);
+    if(end - begin == 1) return index;
+
+    const float *vantage = &templates[node.item].descriptor[0];
+    int mid = (begin + 1 + end) / 2;
+    std::nth_element(items.begin() + begin + 1, items.begin() + mid, items.begin() + end, [&](int a, int b) {
+        return distance(vantage, &templates[a].descriptor[0]) < distance(vantage, &templates[b].descriptor[0]);
+    });
+    float radius = distance(vantage, &templates[items[mid]].descriptor[0]);
+    int inside = buildNode(items, begin + 1, mid);
+    int outside = buildNode(items, mid, end);
+    nodes[index].radius = radius;
+    nodes[index].inside = inside;
+    nodes[index].outside = outside;
+    return index;
+}
+
+//everything inside a node is within radius of its vantage point and everything outside
+//at least that far, so a branch is skipped when the best match so far rules it out
+void PuppetLibrary::search(int index, const float *query, int &best, float &bestDistance) const {
+    if(index < 0) return;
+    const Node &node = nodes[index];
+    float d = distance(query, &templates[node.item].descriptor[0]);
+    if(d < bestDistance) {
+        best = node.item;
+        bestDistance = d;
+    }
+    if(d < node.radius) {
+        if(d - bestDistance <= node.radius) search(node.inside, query, best, bestDistance);
+        if(d + bestDistance >= node.radius) search(node.outside, query, best, bestDistance);
+    } else {
+        if(d + bestDistance >= node.radius) search(node.outside, query, best, bestDistance);
+        if(d - bestDistance <= node.radius) search(node.inside, query, best, bestDistance);
+    }
+}
+
+//bestDistance goes in as the farthest match accepted, -1 when nothing is that close
+int PuppetLibrary::nearest(const vector<float> &query, float &bestDistance) const {
+    int best = -1;
+    search(root, &query[0], best, bestDistance);
+    return best;
+}
@@ -0,0 +1,91 @@
+//
+//  puppetLibrary.h
+//  PS3_Homography
+//
+//  Recognises which puppet casts a shadow, so each one can trigger its own
+//  content. Every outline is described by its log Hu moments and the
+//  magnitudes of its low Fourier coefficients, both unchanged by moving,
+//  rotating or scaling the shadow. The descriptors of the stored templates
+//  (several views per puppet) go into a vantage point tree, so a lookup
+//  touches a few templates rather than the whole library. Results are kept
+//  per tracked label and only looked up again when the blob's area or
+//  perimeter moves, and no more than maxPerFrame lookups run per frame.
+//
+//  library file, one template per line (# starts a comment):
+//    name d0 d1 ... d18
+//
+
+#ifndef PS3_Homography_puppetLibrary_h
+#define PS3_Homography_puppetLibrary_h
+
+#include "ofMain.h"
+#include "trackingFrame.h"
+#include <functional>
+#include <unordered_map>
+
+struct PuppetTemplate {
+    string         name;
+    vector<float>  descriptor;
+};
+
+class PuppetLibrary {
+
+public:
+    PuppetLibrary();
+
+    bool load(const string &path);
+    bool save(const string &path) const;
+    //adds the outline as another view of the named puppet, false when it is too small to describe
+    bool addTemplate(const string &name, const ofPolyline &outline);
+    int  size() const { return templates.size(); }
+
+    //sets puppet and puppetDistance on every blob. outline is asked for the
+    //outlines of blobs without a contour, only when they need a lookup
+    void recognize(vector<TrackedBlob> &blobs, const std::function<void(int, ofPolyline&)> &outline);
+    void reset();
+
+    static const int huCount = 7;
+    static const int fourierCount = 12;
+    static const int descriptorSize = huCount + fourierCount;
+    //false for outlines too short or too degenerate to describe
+    static bool describe(const ofPolyline &outline, vector<float> &descriptor);
+
+    float maxDistance;      //farther than this from every template is no puppet
+    float shapeTolerance;   //relative area or perimeter change that triggers a new lookup
+    int   maxPerFrame;      //lookups per frame, the rest keep their last result until the next frame
+
+    int   getLookupCount() const { return lookups; }    //this frame
+    float getLookupMs() const { return lookupMs; }
+
+private:
+    struct Node {
+        int    item;               //template at the vantage point
+        float  radius;             //median distance to the vantage point
+        int    inside, outside;    //child nodes, -1 for none
+    };
+    struct Match {
+        int    label;
+        float  area, perimeter;    //the shape the result was found for
+        int    item;               //-1 for no puppet
+        float  distance;
+        unsigned long long frame;  //last frame the label was seen
+    };
+
+    static float distance(const float *a, const float *b);
+    void buildIndex();
+    int  buildNode(vector<int> &items, int begin, int end);
+    void search(int node, const float *query, int &best, float &bestDistance) const;
+    int  nearest(const vector<float> &query, float &bestDistance) const;
+
+    vector<PuppetTemplate>            templates;
+    vector<Node>                      nodes;
+    int                               root;
+    std::unordered_map<int, Match>    matches;
+    unsigned long long                frame;
+    int                               lookups;
+    float                             lookupMs;
+    ofPolyline                        traced;
+    vector<float>                     query;
+};
+
+#endif
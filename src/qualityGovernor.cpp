@@ -0,0 +1,95 @@
+//
+//  qualityGovernor.cpp
+//  PS3_Homography
+//
+
+#include "qualityGovernor.h"
+
+static QualityLevel makeLevel(string name, int blur, int circleRes, int particles, int budget, int fidelity, int velIt, int posIt) {
+    QualityLevel level;
+    level.name = name;
+    level.blurSize = blur;
+    level.circleResolution = circleRes;
+    level.maxParticles = particles;
+    level.vertexBudget = budget;
+    level.colliderFidelity = fidelity;
+    level.velocityIterations = velIt;
+    level.positionIterations = posIt;
+    return level;
+}
+
+QualityGovernor::QualityGovernor() {
+    //level 0 matches the hand tuned defaults in setup()
+    levels.push_back(makeLevel("full",    5, 60, 2000, 512, 48, 40, 20));
+    levels.push_back(makeLevel("high",    5, 32, 1500, 384, 32, 20, 10));
+    levels.push_back(makeLevel("medium",  3, 24, 1000, 256, 24, 10, 6));
+    levels.push_back(makeLevel("low",     3, 16,  600, 160, 16, 8, 4));
+    levels.push_back(makeLevel("minimal", 1, 12,  300,  96, 12, 6, 3));
+    
+    overBudget = 1.05;
+    underBudget = 0.8;
+    downFrames = 30;
+    upFrames = 240;
+    cooldownFrames = 120;
+    
+    enabled = false;
+    targetFps = 120;
+    average = 0;
+    current = 0;
+    slowCount = fastCount = cooldown = 0;
+}
+
+void QualityGovernor::setup(float _targetFps) {
+    targetFps = _targetFps;
+    average = 1.0 / targetFps;
+    slowCount = fastCount = 0;
+    cooldown = cooldownFrames;
+}
+
+void QualityGovernor::setEnabled(bool _enabled) {
+    if(enabled == _enabled) return;
+    enabled = _enabled;
+    if(!enabled) current = 0;
+    slowCount = fastCount = 0;
+    cooldown = cooldownFrames;
+    ofLogNotice("QualityGovernor") << (enabled ? "enabled" : "disabled") << " at level '" << levels[current].name << "', target " << targetFps << " fps";
+}
+
+bool QualityGovernor::update(float frameSeconds) {
+    if(frameSeconds <= 0) return false;
+    average += (frameSeconds - average) * 0.1;
+    if(!enabled) return false;
+    if(cooldown > 0) {
+        cooldown--;
+        return false;
+    }
+    
+    float budget = 1.0 / targetFps;
+    if(average > budget * overBudget) {
+        slowCount++;
+        fastCount = 0;
+    } else if(average < budget * underBudget) {
+        fastCount++;
+        slowCount = 0;
+    } else {
+        slowCount = fastCount = 0;
+    }
+    
+    if(slowCount >= downFrames && current < levels.size()-1) {
+        changeLevel(current+1, "over budget");
+        return true;
+    }
+    if(fastCount >= upFrames && current > 0) {
+        changeLevel(current-1, "under budget");
+        return true;
+    }
+    return false;
+}
+
+void QualityGovernor::changeLevel(int level, const string &reason) {
+    ofLogNotice("QualityGovernor") << reason << " (" << ofToString(average*1000.0, 2) << " ms/frame, target "
+        << ofToString(1000.0/targetFps, 2) << " ms): quality '" << levels[current].name << "' -> '" << levels[level].name << "'";
+    current = level;
+    slowCount = fastCount = 0;
+    cooldown = cooldownFrames;
+}
@@ -0,0 +1,64 @@
+//
+//  qualityGovernor.h
+//  PS3_Homography
+//
+//  Watches the measured frame time against a target rate and steps
+//  through a table of quality levels: down when frames stay over budget,
+//  back up only after a long stretch well under it, with a cooldown after
+//  every change so it doesn't oscillate.
+//
+
+#ifndef PS3_Homography_qualityGovernor_h
+#define PS3_Homography_qualityGovernor_h
+
+#include "ofMain.h"
+
+struct QualityLevel {
+    string name;
+    int    blurSize;
+    int    circleResolution;
+    int    maxParticles;        //circles + custom particles
+    int    vertexBudget;        //ContourSimplifier budget
+    int    colliderFidelity;
+    int    velocityIterations;  //box2d solver cost per step
+    int    positionIterations;
+};
+
+class QualityGovernor {
+    
+public:
+    QualityGovernor();
+    
+    void setup(float targetFps);
+    
+    //feed the time the last frame spent working, without any sleep in the frame
+    //limiter or pacer, returns true when the level changed
+    bool update(float frameSeconds);
+    
+    //disabling goes back to level 0, the app restores its hand set values
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    
+    const QualityLevel& getLevel() const { return levels[current]; }
+    int getLevelIndex() const { return current; }
+    float getAverageFrameMs() const { return average * 1000.0; }
+    float getTargetFps() const { return targetFps; }
+    
+    vector<QualityLevel> levels;   //index 0 is the best quality
+    float overBudget;              //fraction of the budget that counts as too slow
+    float underBudget;             //fraction of the budget that counts as fast enough to step up
+    int   downFrames;              //consecutive slow frames before stepping down
+    int   upFrames;                //consecutive fast frames before stepping up
+    int   cooldownFrames;          //frames to ignore after any change
+    
+private:
+    void changeLevel(int level, const string &reason);
+    
+    bool  enabled;
+    float targetFps;
+    float average;
+    int   current;
+    int   slowCount, fastCount, cooldown;
+};
+
+#endif
@@ -0,0 +1,159 @@
+//
+//  runSegmenter.cpp
+//  PS3_Homography
+//
+
+#include "runSegmenter.h"
+#include <limits>
+
+//crack edges overestimate a straight border by 4/pi on average over all directions
+static const float crackToLength = PI / 4;
+
+RunSegmenter::RunSegmenter() {
+    minArea = 0;
+    maxArea = std::numeric_limits<float>::max();
+}
+
+int RunSegmenter::find(int run) {
+    while(parent[run] != run) {
+        parent[run] = parent[parent[run]];
+        run = parent[run];
+    }
+    return run;
+}
+
+//the earlier run stays the root, so components come out in scan order
+void RunSegmenter::join(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if(a == b) return;
+    if(a < b) parent[b] = a;
+    else parent[a] = b;
+}
+
+void RunSegmenter::segment(const ofPixels &mask) {
+    runs.clear();
+    parent.clear();
+    components.clear();
+    runStart.clear();
+    componentRuns.clear();
+    if(!mask.isAllocated()) return;
+
+    int w = mask.getWidth(), h = mask.getHeight();
+    int stride = w * mask.getNumChannels();
+    const unsigned char *data = mask.getData();
+    int prevBegin = 0, prevEnd = 0;
+    for(int y=0; y<h; y++) {
+        const unsigned char *row = data + y * stride;
+        int rowBegin = runs.size();
+        int p = prevBegin;
+        int x = 0;
+        while(x < w) {
+            while(x < w && !row[x]) x++;
+            if(x == w) break;
+            int x0 = x;
+            while(x < w && row[x]) x++;
+
+            Run run;
+            run.y = y;
+            run.x0 = x0;
+            run.x1 = x;
+            run.edges = 2 + 2 * (x - x0);
+            int index = runs.size();
+            runs.push_back(run);
+            parent.push_back(index);
+
+            //runs of the row above that touch this one, diagonally included
+            while(p < prevEnd && runs[p].x1 < x0) p++;
+            for(int q=p; q<prevEnd && runs[q].x0 <= x; q++) {
+                join(q, index);
+                //edges along the shared span are inside the component
+                int shared = MIN(runs[q].x1, x) - MAX(runs[q].x0, x0);
+                if(shared > 0) runs[index].edges -= 2 * shared;
+            }
+        }
+        prevBegin = rowBegin;
+        prevEnd = runs.size();
+    }
+
+    //sum the runs into their components
+    struct Sums {
+        int area, edges, minX, minY, maxX, maxY;
+        double x, y;
+    };
+    vector<int> componentOf(runs.size(), -1);
+    vector<Sums> sums;
+    for(int i=0; i<runs.size(); i++) {
+        int root = find(i);
+        if(componentOf[root] < 0) {
+            componentOf[root] = sums.size();
+            Sums s = { 0, 0, runs[i].x0, runs[i].y, runs[i].x1 - 1, runs[i].y, 0, 0 };
+            sums.push_back(s);
+        }
+        const Run &run = runs[i];
+        Sums &s = sums[componentOf[root]];
+        int length = run.x1 - run.x0;
+        s.area += length;
+        s.edges += run.edges;
+        s.x += length * (run.x0 + run.x1 - 1) * 0.5;
+        s.y += (double)length * run.y;
+        s.minX = MIN(s.minX, run.x0);
+        s.maxX = MAX(s.maxX, run.x1 - 1);
+        s.maxY = run.y;
+        componentOf[i] = componentOf[root];
+    }
+
+    //drop the ones outside the size limits
+    vector<int> kept(sums.size(), -1);
+    for(int c=0; c<sums.size(); c++) {
+        const Sums &s = sums[c];
+        if(s.area < minArea || s.area > maxArea) continue;
+        kept[c] = components.size();
+        RunComponent component;
+        component.area = s.area;
+        component.centroid.set(s.x / s.area, s.y / s.area);
+        component.bounds.set(s.minX, s.minY, s.maxX - s.minX + 1, s.maxY - s.minY + 1);
+        component.perimeter = s.edges * crackToLength;
+        components.push_back(component);
+    }
+
+    //bucket the runs by component, they stay in scan order within each
+    runStart.assign(components.size() + 1, 0);
+    for(int i=0; i<runs.size(); i++) {
+        int c = kept[componentOf[i]];
+        if(c >= 0) runStart[c + 1]++;
+    }
+    for(int c=0; c<components.size(); c++) runStart[c + 1] += runStart[c];
+    componentRuns.resize(runStart.back());
+    vector<int> fill(runStart.begin(), runStart.end() - 1);
+    for(int i=0; i<runs.size(); i++) {
+        int c = kept[componentOf[i]];
+        if(c >= 0) componentRuns[fill[c]++] = i;
+    }
+}
+
+//redraws the component's runs into a padded patch of its bounds and
+//follows the outer border there, so the cost is the blob's size only
+void RunSegmenter::traceOutline(int i, ofPolyline &outline) {
+    outline.clear();
+    const RunComponent &component = components[i];
+    int left = component.bounds.x, top = component.bounds.y;
+    scratch.create(component.bounds.height + 2, component.bounds.width + 2, CV_8UC1);
+    scratch.setTo(0);
+    for(int k=runStart[i]; k<runStart[i + 1]; k++) {
+        const Run &run = runs[componentRuns[k]];
+        scratch.row(run.y - top + 1).colRange(run.x0 - left + 1, run.x1 - left + 1).setTo(255);
+    }
+
+    vector<vector<cv::Point> > contours;
+    cv::findContours(scratch, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE, cv::Point(left - 1, top - 1));
+    int longest = -1;
+    for(int c=0; c<contours.size(); c++) {
+        if(longest < 0 || contours[c].size() > contours[longest].size()) longest = c;
+    }
+    if(longest < 0) return;
+    for(int k=0; k<contours[longest].size(); k++) {
+        outline.addVertex(contours[longest][k].x, contours[longest][k].y);
+    }
+    outline.setClosed(true);
+}
@@ -0,0 +1,60 @@
+//
+//  runSegmenter.h
+//  PS3_Homography
+//
+//  Connected components of the tracking mask without tracing every border.
+//  Each row is run-length encoded as it is scanned and its runs are joined
+//  to the 8-connected runs of the row above with a union-find, so area,
+//  centroid, bounds and perimeter come out of one pass over the pixels.
+//  Outlines are traced afterwards, and only for the components that ask
+//  for one, from that component's runs alone.
+//
+
+#ifndef PS3_Homography_runSegmenter_h
+#define PS3_Homography_runSegmenter_h
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+struct RunComponent {
+    int          area;          //pixels
+    ofVec2f      centroid;
+    ofRectangle  bounds;
+    float        perimeter;     //estimated from the run edges, in pixels
+};
+
+class RunSegmenter {
+
+public:
+    RunSegmenter();
+
+    //labels the non-zero pixels of a one channel mask
+    void segment(const ofPixels &mask);
+
+    int size() const { return components.size(); }
+    const RunComponent& getComponent(int i) const { return components[i]; }
+    //outer border of component i, as findContours would trace it
+    void traceOutline(int i, ofPolyline &outline);
+
+    int getRunCount() const { return runs.size(); }
+
+    float minArea, maxArea;     //pixels, components outside are dropped
+
+private:
+    struct Run {
+        int y, x0, x1;          //x1 is one past the last pixel
+        int edges;              //crack edges of this run not shared with the row above
+    };
+
+    int find(int run);
+    void join(int a, int b);
+
+    vector<Run>          runs;
+    vector<int>          parent;
+    vector<RunComponent> components;
+    //runs of component i are componentRuns[runStart[i]] .. componentRuns[runStart[i+1]-1]
+    vector<int>          runStart, componentRuns;
+    cv::Mat              scratch;
+};
+
+#endif
@@ -0,0 +1,124 @@
+//
+//  sceneSnapshot.cpp
+//  PS3_Homography
+//
+
+#include "sceneSnapshot.h"
+#include <fstream>
+#include <cstdio>
+
+static const uint32_t snapshotMagic = 0x4e535053;   //"SPSN"
+static const uint32_t snapshotVersion = 1;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bodySize;
+    uint32_t bodyCount;
+    uint64_t savedMicros;
+};
+
+SceneSnapshot::SceneSnapshot() {
+    memset(&params, 0, sizeof(params));
+    savedMicros = 0;
+}
+
+bool SceneSnapshot::save(const string &path) const {
+    string full = ofToDataPath(path, true);
+    string temp = full + ".tmp";
+    std::ofstream out(temp.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out) {
+        ofLogError("SceneSnapshot") << "couldn't open " << temp;
+        return false;
+    }
+    SnapshotHeader header;
+    header.magic = snapshotMagic;
+    header.version = snapshotVersion;
+    header.bodySize = sizeof(SnapshotBody);
+    header.bodyCount = bodies.size();
+    header.savedMicros = savedMicros;
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)&params, sizeof(params));
+    if(!bodies.empty()) out.write((const char*)&bodies[0], bodies.size() * sizeof(SnapshotBody));
+    out.close();
+    if(!out) {
+        ofLogError("SceneSnapshot") << "write failed for " << temp;
+        return false;
+    }
+    return std::rename(temp.c_str(), full.c_str()) == 0;
+}
+
+bool SceneSnapshot::load(const string &path) {
+    std::ifstream in(ofToDataPath(path, true).c_str(), std::ios::binary);
+    if(!in) return false;
+    SnapshotHeader header;
+    in.read((char*)&header, sizeof(header));
+    if(!in || header.magic != snapshotMagic) {
+        ofLogWarning("SceneSnapshot") << path << " is not a scene snapshot";
+        return false;
+    }
+    if(header.version != snapshotVersion || header.bodySize != sizeof(SnapshotBody)) {
+        ofLogWarning("SceneSnapshot") << path << " was written by a different version, ignoring it";
+        return false;
+    }
+    in.read((char*)&params, sizeof(params));
+    bodies.resize(header.bodyCount);
+    if(header.bodyCount > 0) in.read((char*)&bodies[0], header.bodyCount * sizeof(SnapshotBody));
+    if(!in) {
+        ofLogWarning("SceneSnapshot") << path << " is truncated";
+        bodies.clear();
+        return false;
+    }
+    savedMicros = header.savedMicros;
+    return true;
+}
+
+//--------------------------------------------------------------
+SnapshotWriter::SnapshotWriter() {
+    hasPending = false;
+    writes = 0;
+    lastWriteMs = 0;
+}
+
+void SnapshotWriter::setup(const string &_path) {
+    path = _path;
+    startThread();
+}
+
+void SnapshotWriter::submit(const SceneSnapshot &snapshot) {
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        pending = snapshot;     //an unwritten older snapshot is simply replaced
+        hasPending = true;
+    }
+    wake.notify_one();
+}
+
+void SnapshotWriter::stop() {
+    stopThread();
+    wake.notify_one();
+    waitForThread(false);
+}
+
+void SnapshotWriter::threadedFunction() {
+    SceneSnapshot writing;
+    while(isThreadRunning()) {
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            wake.wait_for(guard, std::chrono::milliseconds(250));
+            if(!hasPending) continue;
+            std::swap(writing, pending);
+            hasPending = false;
+        }
+        uint64_t start = ofGetElapsedTimeMicros();
+        if(writing.save(path)) writes++;
+        lastWriteMs = (ofGetElapsedTimeMicros() - start) / 1000.0;
+    }
+    
+    //flush whatever came in last
+    std::unique_lock<std::mutex> guard(mutex);
+    if(hasPending) {
+        pending.save(path);
+        hasPending = false;
+    }
+}
@@ -0,0 +1,79 @@
+//
+//  sceneSnapshot.h
+//  PS3_Homography
+//
+//  Compact binary copy of the box2d scene (circles, custom particles and
+//  the physics settings) so a restarted app can put everything back where
+//  it was. Capturing reads the world and has to happen on the thread that
+//  steps it; the SnapshotWriter then does the file io on its own thread.
+//
+
+#ifndef PS3_Homography_sceneSnapshot_h
+#define PS3_Homography_sceneSnapshot_h
+
+#include "ofMain.h"
+#include <stdint.h>
+#include <condition_variable>
+
+enum SnapshotBodyKind {
+    SNAPSHOT_CIRCLE = 0,
+    SNAPSHOT_PARTICLE = 1
+};
+
+struct SnapshotBody {
+    uint8_t kind;
+    uint8_t r, g, b;
+    float   x, y;                 //screen pixels
+    float   vx, vy;
+    float   angle, angularVelocity;
+    float   radius;
+    float   density, bounce, friction;
+};
+
+struct SnapshotParams {
+    uint8_t gravityOn;
+    uint8_t wallsOn;
+    uint8_t reserved[2];
+    float   gravityX, gravityY;
+    float   circleMin, circleMax, circleFreq;
+    int32_t maxParticles;   //informational, restore takes it from the quality level
+};
+
+class SceneSnapshot {
+    
+public:
+    SceneSnapshot();
+    
+    //written to a temp file and renamed over path so a crash never leaves half a snapshot
+    bool save(const string &path) const;
+    bool load(const string &path);
+    
+    SnapshotParams         params;
+    vector<SnapshotBody>   bodies;
+    uint64_t               savedMicros;
+};
+
+class SnapshotWriter : public ofThread {
+    
+public:
+    SnapshotWriter();
+    
+    void setup(const string &path);
+    void submit(const SceneSnapshot &snapshot);   //never blocks on disk
+    void stop();
+    
+    int getWriteCount() const { return writes; }
+    float getLastWriteMs() const { return lastWriteMs; }
+    
+private:
+    void threadedFunction();
+    
+    string                   path;
+    SceneSnapshot            pending;
+    bool                     hasPending;
+    std::condition_variable  wake;
+    int                      writes;
+    float                    lastWriteMs;
+};
+
+#endif
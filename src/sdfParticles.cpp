@@ -0,0 +1,212 @@
+//
+//  sdfParticles.cpp
+//  PS3_Homography
+//
+
+#include "sdfParticles.h"
+
+//xorshift, one state per chunk so threads don't share a generator
+static inline float nextRandom(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state & 0xffffff) / 16777216.0f;
+}
+
+SdfParticleSystem::SdfParticleSystem() {
+    mode = SDF_SAND;
+    gravity.set(0, 200);
+    damping = 0.8;
+    radius = 1.5;
+    restitution = 0.1;
+    friction = 0.05;
+    smokeLife = 3.0;
+    pointSize = 1.0;
+    sandColor.set(230, 200, 140);
+    smokeColor.set(180, 180, 200, 40);
+    width = 320;
+    height = 240;
+    vboCount = 0;
+    dirty = false;
+    numThreads = 1;
+    remaining = 0;
+    frameSeed = 1;
+    updateMs = 0;
+}
+
+void SdfParticleSystem::setup(int _numThreads) {
+    numThreads = MAX(1, _numThreads);
+    pool.start(numThreads);
+}
+
+void SdfParticleSystem::setCount(int count) {
+    int old = px.size();
+    if(count == old) return;
+    px.resize(count);
+    py.resize(count);
+    vx.resize(count);
+    vy.resize(count);
+    life.resize(count);
+    vertices.resize(count * 2);
+    uint32_t rng = 0x9e3779b9 ^ count;
+    for(int i=old; i<count; i++) {
+        spawn(i, rng);
+        //start spread out instead of all on the spawn edge
+        px[i] = nextRandom(rng) * width;
+        py[i] = nextRandom(rng) * height;
+        life[i] = nextRandom(rng);
+    }
+}
+
+void SdfParticleSystem::setBounds(float _width, float _height) {
+    if(_width == width && _height == height) return;
+    width = _width;
+    height = _height;
+    field = cv::Mat();
+    int count = px.size();
+    setCount(0);
+    setCount(count);
+}
+
+void SdfParticleSystem::setField(const cv::Mat &distance) {
+    if(distance.empty() || (distance.cols == width && distance.rows == height)) field = distance;
+}
+
+void SdfParticleSystem::setEmitters(const vector<ofPoint> &points) {
+    emitters = points;
+}
+
+//a fresh particle: sand on the edge gravity comes from, smoke on an outline
+void SdfParticleSystem::spawn(int i, uint32_t &rng) {
+    vx[i] = vy[i] = 0;
+    life[i] = 1;
+    if(mode == SDF_SMOKE && !emitters.empty()) {
+        const ofPoint &p = emitters[(int)(nextRandom(rng) * emitters.size()) % emitters.size()];
+        px[i] = p.x + nextRandom(rng) * 2 - 1;
+        py[i] = p.y + nextRandom(rng) * 2 - 1;
+        vx[i] = (nextRandom(rng) - 0.5) * 20;
+        vy[i] = (nextRandom(rng) - 0.5) * 20;
+        return;
+    }
+    if(fabs(gravity.y) >= fabs(gravity.x)) {
+        px[i] = nextRandom(rng) * width;
+        py[i] = gravity.y >= 0 ? 0 : height - 1;
+    } else {
+        px[i] = gravity.x >= 0 ? 0 : width - 1;
+        py[i] = nextRandom(rng) * height;
+    }
+}
+
+void SdfParticleSystem::integrate(int begin, int end, float dt, uint32_t rng) {
+    float *x = &px[0], *y = &py[0], *u = &vx[0], *v = &vy[0], *l = &life[0];
+    
+    //smoke is lighter than air: it rises against gravity
+    float ax = mode == SDF_SMOKE ? -gravity.x * 0.3f : gravity.x;
+    float ay = mode == SDF_SMOKE ? -gravity.y * 0.3f : gravity.y;
+    float keep = pow(damping, dt);
+    float fade = mode == SDF_SMOKE ? dt / MAX(smokeLife, 0.01f) : 0;
+    
+    //straight-line float math over plain arrays, the compiler vectorizes this
+    for(int i=begin; i<end; i++) {
+        u[i] = u[i] * keep + ax * dt;
+        v[i] = v[i] * keep + ay * dt;
+        x[i] += u[i] * dt;
+        y[i] += v[i] * dt;
+        l[i] -= fade;
+    }
+    
+    //collisions with the shadows, then respawn what left
+    int fw = field.cols, fh = field.rows;
+    const float *f = field.empty() ? NULL : field.ptr<float>();
+    size_t stride = field.empty() ? 0 : field.step1();
+    for(int i=begin; i<end; i++) {
+        int cx = x[i], cy = y[i];
+        if(f && cx >= 1 && cy >= 1 && cx < fw - 1 && cy < fh - 1) {
+            const float *row = f + cy * stride;
+            float d = row[cx];
+            if(d < radius) {
+                //the distance gradient points out of the shadow
+                float gx = row[cx + 1] - row[cx - 1];
+                float gy = row[cx + stride] - row[cx - stride];
+                float len = sqrt(gx * gx + gy * gy);
+                float nx = 0, ny = -1;
+                if(len > 1e-4f) {
+                    nx = gx / len;
+                    ny = gy / len;
+                } else if(ax != 0 || ay != 0) {
+                    //flat spot deep inside a shadow, push against gravity
+                    float n = sqrt(ax * ax + ay * ay);
+                    nx = -ax / n;
+                    ny = -ay / n;
+                }
+                float push = radius - d;
+                x[i] += nx * push;
+                y[i] += ny * push;
+                float vn = u[i] * nx + v[i] * ny;
+                if(vn < 0) {
+                    u[i] -= (1 + restitution) * vn * nx;
+                    v[i] -= (1 + restitution) * vn * ny;
+                    u[i] *= 1 - friction;
+                    v[i] *= 1 - friction;
+                }
+            }
+        }
+        if(x[i] < 0 || y[i] < 0 || x[i] >= width || y[i] >= height || l[i] <= 0) spawn(i, rng);
+        vertices[i * 2] = x[i];
+        vertices[i * 2 + 1] = y[i];
+    }
+}
+
+void SdfParticleSystem::update(float dt) {
+    int count = px.size();
+    if(count == 0) return;
+    unsigned long long start = ofGetElapsedTimeMicros();
+    dt = ofClamp(dt, 0.001f, 1.0f / 15.0f);
+    frameSeed++;
+    
+    //a couple of chunks per thread so stealing can even out the load
+    int chunks = MIN(numThreads * 2, MAX(1, count / 1024));
+    int chunkSize = (count + chunks - 1) / chunks;
+    {
+        std::unique_lock<std::mutex> guard(doneMutex);
+        remaining = chunks;
+    }
+    for(int c=0; c<chunks; c++) {
+        int begin = c * chunkSize;
+        int end = MIN(count, begin + chunkSize);
+        uint32_t seed = (frameSeed * 2654435761u) ^ (c * 40503u + 1);
+        pool.submit([this, begin, end, dt, seed] {
+            integrate(begin, end, dt, seed);
+            std::unique_lock<std::mutex> guard(doneMutex);
+            if(--remaining == 0) done.notify_all();
+        });
+    }
+    std::unique_lock<std::mutex> guard(doneMutex);
+    done.wait(guard, [this] { return remaining == 0; });
+    updateMs = (ofGetElapsedTimeMicros() - start) / 1000.0;
+    dirty = true;
+}
+
+void SdfParticleSystem::draw() {
+    int count = px.size();
+    if(count == 0) return;
+    //uploaded once per update, however many outputs draw it
+    if(count != vboCount) {
+        vbo.setVertexData(&vertices[0], 2, count, GL_DYNAMIC_DRAW);
+        vboCount = count;
+    } else if(dirty) {
+        vbo.updateVertexData(&vertices[0], count);
+    }
+    dirty = false;
+    
+    ofPushStyle();
+    if(mode == SDF_SMOKE) {
+        ofEnableBlendMode(OF_BLENDMODE_ADD);
+        ofSetColor(smokeColor);
+    } else {
+        ofSetColor(sandColor);
+    }
+    glPointSize(pointSize);
+    vbo.draw(GL_POINTS, 0, count);
+    ofPopStyle();
+}
@@ -0,0 +1,79 @@
+//
+//  sdfParticles.h
+//  PS3_Homography
+//
+//  A second particle engine for dense sand and smoke, next to box2d.
+//  Particles are plain arrays of floats (x, y, vx, vy, life) updated in
+//  chunks on worker threads. They don't collide with bodies or with each
+//  other, only with a signed distance field of the tracking mask:
+//  positive outside the shadows, negative inside. Everything runs in
+//  warped camera pixels. The whole system is drawn as one vertex buffer
+//  of points.
+//
+
+#ifndef PS3_Homography_sdfParticles_h
+#define PS3_Homography_sdfParticles_h
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "framePipeline.h"
+
+enum SdfParticleMode {
+    SDF_SAND = 0,       //falls with gravity, slides off the shadows, comes back at the top
+    SDF_SMOKE           //rises from the shadow outlines and fades out
+};
+
+class SdfParticleSystem {
+    
+public:
+    SdfParticleSystem();
+    
+    void setup(int numThreads);
+    void setCount(int count);
+    int getCount() const { return px.size(); }
+    
+    //the area particles live in, camera pixels. a new size respawns everything
+    void setBounds(float width, float height);
+    //signed distances as CV_32F at the bounds size, empty to turn collisions off
+    void setField(const cv::Mat &distance);
+    //smoke comes out of these points, the shadow outlines
+    void setEmitters(const vector<ofPoint> &points);
+    
+    void update(float dt);
+    void draw();
+    
+    float getUpdateMs() const { return updateMs; }
+    
+    SdfParticleMode mode;
+    ofVec2f gravity;        //pixels/s^2
+    float   damping;        //velocity kept per second
+    float   radius;         //collision distance from a shadow, pixels
+    float   restitution, friction;
+    float   smokeLife;      //seconds
+    float   pointSize;
+    ofColor sandColor, smokeColor;
+    
+private:
+    void integrate(int begin, int end, float dt, uint32_t seed);
+    void spawn(int i, uint32_t &rng);
+    
+    vector<float>       px, py, vx, vy, life;
+    vector<float>       vertices;       //interleaved x,y for the vbo
+    vector<ofPoint>     emitters;
+    cv::Mat             field;
+    float               width, height;
+    
+    ofVbo               vbo;
+    int                 vboCount;
+    bool                dirty;
+    
+    WorkStealingPool    pool;
+    int                 numThreads;
+    std::mutex          doneMutex;
+    std::condition_variable done;
+    int                 remaining;
+    uint32_t            frameSeed;
+    float               updateMs;
+};
+
+#endif
@@ -0,0 +1,253 @@
+//
+//  sharedRing.cpp
+//  PS3_Homography
+//
+
+#include "sharedRing.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static const uint32_t ringMagic = 0x47525053;    //"SPRG"
+static const uint32_t ringVersion = 2;
+static const size_t ringHeaderBytes = 64;
+
+static size_t align64(size_t bytes) {
+    return (bytes + 63) & ~(size_t)63;
+}
+
+SharedRing::SharedRing() {
+    owner = false;
+    reader = false;
+    fd = -1;
+    mapped = NULL;
+    mappedBytes = 0;
+    slotStride = 0;
+    header = NULL;
+    readIndex = 0;
+    dropped = 0;
+    writing = NULL;
+}
+
+SharedRing::~SharedRing() {
+    close();
+}
+
+bool SharedRing::create(const string &_name, int slotCount, int slotBytes) {
+    string next = _name[0] == '/' ? _name : "/" + _name;
+    //before close(), which would unlink our own segment
+    uint32_t generation = retire(next) + 1;
+    close();
+    name = next;
+    //readers keep one slot free of the writer
+    if(slotCount < 2 || slotBytes <= 0) {
+        ofLogError("SharedRing") << name << " needs at least 2 slots of at least 1 byte";
+        return false;
+    }
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0) {
+        ofLogError("SharedRing") << "shm_open " << name << " failed: " << strerror(errno);
+        return false;
+    }
+    slotStride = slotHeaderBytes + align64(slotBytes);
+    mappedBytes = ringHeaderBytes + slotStride * slotCount;
+    if(ftruncate(fd, mappedBytes) != 0) {
+        ofLogError("SharedRing") << "couldn't size " << name << " to " << mappedBytes << " bytes";
+        close();
+        return false;
+    }
+    mapped = mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) {
+        mapped = NULL;
+        close();
+        return false;
+    }
+    owner = true;
+    memset(mapped, 0, mappedBytes);
+    header = (SharedRingHeader*)mapped;
+    header->slotCount = slotCount;
+    header->slotBytes = slotBytes;
+    header->version = ringVersion;
+    header->generation = generation;
+    header->written.store(0);
+    //magic last, readers check it before trusting the rest
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = ringMagic;
+    return true;
+}
+
+bool SharedRing::open(const string &_name) {
+    close();
+    name = _name[0] == '/' ? _name : "/" + _name;
+    dropped = 0;
+    reader = attach(false);
+    return reader;
+}
+
+bool SharedRing::attach(bool fromStart) {
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0) return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)ringHeaderBytes) {
+        unmap();
+        return false;
+    }
+    mappedBytes = info.st_size;
+    mapped = mmap(NULL, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) {
+        mapped = NULL;
+        unmap();
+        return false;
+    }
+    header = (SharedRingHeader*)mapped;
+    if(header->magic != ringMagic || header->version != ringVersion) {
+        ofLogWarning("SharedRing") << name << " is not a version " << ringVersion << " ring";
+        unmap();
+        return false;
+    }
+    //the writer could be anything that got the magic right, don't index past the mapping
+    uint64_t needed = ringHeaderBytes + (uint64_t)(slotHeaderBytes + align64(header->slotBytes)) * header->slotCount;
+    if(header->slotCount < 2 || header->slotBytes == 0 || needed > mappedBytes) {
+        ofLogWarning("SharedRing") << name << " has " << header->slotCount << " slots of " << header->slotBytes
+            << " bytes, more than its " << mappedBytes << " bytes";
+        unmap();
+        return false;
+    }
+    slotStride = slotHeaderBytes + align64(header->slotBytes);
+    //a new segment only holds frames we haven't seen
+    readIndex = fromStart ? 0 : header->written.load(std::memory_order_acquire);
+    return true;
+}
+
+//false while the writer has no segment up under the name
+bool SharedRing::reattach() {
+    if(!reader) return header != NULL;
+    if(header != NULL) {
+        if(!header->retired.load(std::memory_order_acquire)) return true;
+        unmap();
+        ofLogNotice("SharedRing") << name << " was replaced by the writer, reattaching";
+    }
+    return attach(true);
+}
+
+//marks a segment left under the name as retired so its readers move on, returns its generation
+uint32_t SharedRing::retire(const string &name) {
+    int old = shm_open(name.c_str(), O_RDWR, 0);
+    if(old < 0) return 0;
+    uint32_t generation = 0;
+    struct stat info;
+    if(fstat(old, &info) == 0 && info.st_size >= (off_t)ringHeaderBytes) {
+        void *p = mmap(NULL, ringHeaderBytes, PROT_READ | PROT_WRITE, MAP_SHARED, old, 0);
+        if(p != MAP_FAILED) {
+            SharedRingHeader *h = (SharedRingHeader*)p;
+            if(h->magic == ringMagic && h->version == ringVersion) {
+                generation = h->generation;
+                h->retired.store(1, std::memory_order_release);
+            }
+            munmap(p, ringHeaderBytes);
+        }
+    }
+    ::close(old);
+    return generation;
+}
+
+void SharedRing::close() {
+    unmap();
+    reader = false;
+}
+
+void SharedRing::unmap() {
+    if(owner && header != NULL) header->retired.store(1, std::memory_order_release);
+    if(mapped) munmap(mapped, mappedBytes);
+    if(fd >= 0) ::close(fd);
+    if(owner) shm_unlink(name.c_str());
+    mapped = NULL;
+    header = NULL;
+    fd = -1;
+    owner = false;
+    writing = NULL;
+}
+
+SharedRingSlot* SharedRing::slot(uint64_t index) const {
+    return (SharedRingSlot*)((unsigned char*)mapped + ringHeaderBytes + slotStride * (index % header->slotCount));
+}
+
+unsigned char* SharedRing::beginWrite() {
+    if(!owner || header == NULL) return NULL;
+    writing = slot(header->written.load(std::memory_order_relaxed));
+    writing->sequence.fetch_add(1, std::memory_order_acq_rel);     //odd: in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    return payload(writing);
+}
+
+void SharedRing::endWrite(size_t bytes, uint64_t timestamp, uint32_t tag) {
+    if(writing == NULL) return;
+    uint64_t index = header->written.load(std::memory_order_relaxed);
+    writing->index = index;
+    writing->timestamp = timestamp;
+    writing->length = MIN(bytes, (size_t)header->slotBytes);
+    writing->tag = tag;
+    writing->sequence.fetch_add(1, std::memory_order_release);     //even: stable
+    header->written.store(index + 1, std::memory_order_release);
+    writing = NULL;
+}
+
+bool SharedRing::write(const void *data, size_t bytes, uint64_t timestamp, uint32_t tag) {
+    if(bytes > getSlotBytes()) return false;
+    unsigned char *dst = beginWrite();
+    if(dst == NULL) return false;
+    memcpy(dst, data, bytes);
+    endWrite(bytes, timestamp, tag);
+    return true;
+}
+
+bool SharedRing::readNext(vector<unsigned char> &out, uint64_t &timestamp, uint32_t &tag) {
+    if(!reattach()) return false;
+    for(int attempt=0; attempt<4; attempt++) {
+        uint64_t written = header->written.load(std::memory_order_acquire);
+        if(readIndex >= written) return false;
+        //lapped: everything older than one ring behind is gone
+        if(written - readIndex > header->slotCount - 1) {
+            uint64_t skipTo = written - (header->slotCount - 1);
+            dropped += skipTo - readIndex;
+            readIndex = skipTo;
+        }
+        SharedRingSlot *s = slot(readIndex);
+        uint64_t before = s->sequence.load(std::memory_order_acquire);
+        if(before & 1) continue;
+        size_t length = MIN((size_t)s->length, (size_t)header->slotBytes);
+        uint64_t index = s->index;
+        timestamp = s->timestamp;
+        tag = s->tag;
+        out.resize(length);
+        if(length > 0) memcpy(&out[0], payload(s), length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(s->sequence.load(std::memory_order_relaxed) != before || index != readIndex) continue;
+        readIndex++;
+        return true;
+    }
+    return false;
+}
+
+const unsigned char* SharedRing::peekLatest(uint64_t &sequence, size_t &bytes, uint64_t &timestamp, uint32_t &tag) {
+    if(!reattach()) return NULL;
+    uint64_t written = header->written.load(std::memory_order_acquire);
+    if(written == 0) return NULL;
+    SharedRingSlot *s = slot(written - 1);
+    sequence = s->sequence.load(std::memory_order_acquire);
+    if(sequence & 1) return NULL;
+    bytes = s->length;
+    timestamp = s->timestamp;
+    tag = s->tag;
+    return payload(s);
+}
+
+bool SharedRing::validate(const unsigned char *data, uint64_t sequence) const {
+    SharedRingSlot *s = (SharedRingSlot*)(data - slotHeaderBytes);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s->sequence.load(std::memory_order_relaxed) == sequence;
+}
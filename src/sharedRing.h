@@ -0,0 +1,95 @@
+//
+//  sharedRing.h
+//  PS3_Homography
+//
+//  A ring of fixed-size slots in POSIX shared memory, written by this app
+//  and read by any number of other processes. Every slot is guarded by a
+//  seqlock: the writer makes the sequence odd, copies, then makes it even,
+//  so it never waits for anybody. Readers copy (or use in place) and then
+//  check the sequence didn't move; a reader that was too slow just retries
+//  on a newer slot. When the writer replaces the segment (new slot size,
+//  restart) it marks the old one retired first, and readers map the new
+//  one on their next read.
+//
+
+#ifndef PS3_Homography_sharedRing_h
+#define PS3_Homography_sharedRing_h
+
+#include "ofMain.h"
+#include <atomic>
+#include <stdint.h>
+
+struct SharedRingHeader {
+    uint32_t               magic;
+    uint32_t               version;
+    uint32_t               slotCount;
+    uint32_t               slotBytes;      //payload bytes per slot
+    std::atomic<uint64_t>  written;        //number of slots ever published
+    std::atomic<uint32_t>  retired;        //set when the writer replaced or removed the segment
+    uint32_t               generation;     //one more than the segment it replaced
+};
+
+struct SharedRingSlot {
+    std::atomic<uint64_t>  sequence;       //odd while being written
+    uint64_t               index;          //which write this is (written-1 at publish time)
+    uint64_t               timestamp;      //producer supplied, usually capture micros
+    uint32_t               length;
+    uint32_t               tag;            //producer supplied, e.g. stream or packet type
+    //payload follows, padded to 64 bytes
+};
+
+class SharedRing {
+    
+public:
+    SharedRing();
+    ~SharedRing();
+    
+    //producer side, replaces any existing segment with the same name
+    bool create(const string &name, int slotCount, int slotBytes);
+    //consumer side, follows the writer to a new segment under the same name until close()
+    bool open(const string &name);
+    void close();
+    bool isOpen() const { return header != NULL; }
+    
+    int getSlotBytes() const { return header ? header->slotBytes : 0; }
+    int getSlotCount() const { return header ? header->slotCount : 0; }
+    uint32_t getGeneration() const { return header ? header->generation : 0; }
+    uint64_t getWrittenCount() const { return header ? header->written.load(std::memory_order_acquire) : 0; }
+    
+    //---writer: either write() in one go, or beginWrite()/endWrite() to fill a slot in place
+    bool write(const void *data, size_t bytes, uint64_t timestamp, uint32_t tag = 0);
+    unsigned char* beginWrite();
+    void endWrite(size_t bytes, uint64_t timestamp, uint32_t tag = 0);
+    
+    //---reader: copies the next unread slot (skipping ahead if the writer lapped us)
+    bool readNext(vector<unsigned char> &out, uint64_t &timestamp, uint32_t &tag);
+    uint64_t getDropped() const { return dropped; }
+    
+    //zero copy read of the newest slot: use the pointer, then validate()
+    const unsigned char* peekLatest(uint64_t &sequence, size_t &bytes, uint64_t &timestamp, uint32_t &tag);
+    bool validate(const unsigned char *payload, uint64_t sequence) const;
+    
+private:
+    bool attach(bool fromStart);
+    bool reattach();
+    static uint32_t retire(const string &name);
+    void unmap();
+    SharedRingSlot* slot(uint64_t index) const;
+    unsigned char* payload(SharedRingSlot *s) const { return (unsigned char*)s + slotHeaderBytes; }
+    
+    static const size_t slotHeaderBytes = 64;
+    
+    string             name;
+    bool               owner;
+    bool               reader;
+    int                fd;
+    void*              mapped;
+    size_t             mappedBytes;
+    size_t             slotStride;
+    SharedRingHeader*  header;
+    uint64_t           readIndex;
+    uint64_t           dropped;
+    SharedRingSlot*    writing;
+};
+
+#endif
@@ -0,0 +1,218 @@
+//
+//  showRecorder.cpp
+//  PS3_Homography
+//
+
+#include "showRecorder.h"
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+//a gap longer than this (the app was paused) is not filled with repeated frames
+static const float maxGapSeconds = 2;
+
+ShowRecorder::ShowRecorder() {
+    maxQueued = 8;
+    encoderCommand = "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgb24 -s %wx%h -r %fps -i - "
+                     "-vf vflip -c:v libx264 -preset ultrafast -crf 18 -pix_fmt yuv420p \"%path\"";
+    recording = false;
+    output = RECORD_FFMPEG;
+    fps = 30;
+    startMicros = 0;
+    lastTick = writtenTick = -1;
+    pboPending[0] = pboPending[1] = false;
+    pboTick[0] = pboTick[1] = 0;
+    pboIndex = 0;
+    pipe = NULL;
+    written = 0;
+    dropped = 0;
+    failed = false;
+}
+
+ShowRecorder::~ShowRecorder() {
+    stop();
+}
+
+bool ShowRecorder::start(const string &_path, RecorderOutput _output, const ofRectangle &_area, float _fps) {
+    stop();
+    path = _path;
+    output = _output;
+    fps = _fps;
+    //whole pixels inside the window, even sizes for the encoder's chroma subsampling
+    area = _area.getIntersection(ofRectangle(0, 0, ofGetWidth(), ofGetHeight()));
+    area.set((int)area.x, (int)area.y, (int)area.width & ~1, (int)area.height & ~1);
+    if(area.width <= 0 || area.height <= 0) {
+        ofLogError("ShowRecorder") << "nothing to record, the outputs are outside the window";
+        return false;
+    }
+
+    if(output == RECORD_FFMPEG) {
+        //an encoder that exits makes writes fail with EPIPE instead of killing the app
+        signal(SIGPIPE, SIG_IGN);
+        string command = encoderCommand;
+        ofStringReplace(command, "%w", ofToString((int)area.width));
+        ofStringReplace(command, "%h", ofToString((int)area.height));
+        ofStringReplace(command, "%fps", ofToString(fps));
+        ofStringReplace(command, "%path", path);
+        pipe = popen(command.c_str(), "w");
+        if(!pipe) {
+            ofLogError("ShowRecorder") << "could not start " << command;
+            return false;
+        }
+    } else {
+        ofDirectory::createDirectory(path, false, true);
+    }
+
+    int bytes = area.width * area.height * 3;
+    for(int i=0; i<2; i++) {
+        pbo[i].allocate(bytes, GL_STREAM_READ);
+        pboPending[i] = false;
+    }
+    pboIndex = 0;
+    queue.clear();
+    spare.clear();
+    written = 0;
+    dropped = 0;
+    failed = false;
+    lastTick = writtenTick = -1;
+    startMicros = ofGetElapsedTimeMicros();
+    recording = true;
+    startThread();
+    ofLogNotice("ShowRecorder") << "recording " << area.width << "x" << area.height << " at " << fps << " fps to " << path;
+    return true;
+}
+
+void ShowRecorder::stop() {
+    if(!recording) return;
+    //the frame still in flight on the gpu goes out too
+    collect(1 - pboIndex);
+    recording = false;
+    stopThread();
+    wake.notify_one();
+    waitForThread(false);
+    if(pipe) {
+        pclose(pipe);
+        pipe = NULL;
+    }
+    ofLogNotice("ShowRecorder") << path << ": " << written << " frames written, " << dropped << " dropped";
+}
+
+int ShowRecorder::getQueueDepth() {
+    std::unique_lock<std::mutex> guard(mutex);
+    return queue.size();
+}
+
+void ShowRecorder::capture() {
+    if(!recording) return;
+    if(failed) {
+        stop();
+        return;
+    }
+    long long tick = (ofGetElapsedTimeMicros() - startMicros) * fps / 1000000;
+    if(tick == lastTick) return;
+    lastTick = tick;
+
+    //the buffer read back last time has had a whole frame to arrive
+    collect(1 - pboIndex);
+
+    ofBufferObject &target = pbo[pboIndex];
+    target.bind(GL_PIXEL_PACK_BUFFER);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(area.x, ofGetHeight() - area.y - area.height, area.width, area.height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    target.unbind(GL_PIXEL_PACK_BUFFER);
+    pboPending[pboIndex] = true;
+    pboTick[pboIndex] = tick;
+    pboIndex = 1 - pboIndex;
+}
+
+//copies a finished readback out of its pixel buffer and queues it for the worker
+void ShowRecorder::collect(int index) {
+    if(!pboPending[index]) return;
+    pboPending[index] = false;
+
+    FramePtr frame;
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        if(queue.size() >= maxQueued) {
+            dropped++;
+            return;
+        }
+        if(!spare.empty()) {
+            frame = spare.back();
+            spare.pop_back();
+        }
+    }
+    if(!frame) frame = FramePtr(new Frame);
+    frame->pixels.resize(area.width * area.height * 3);
+    frame->tick = pboTick[index];
+
+    ofBufferObject &ready = pbo[index];
+    ready.bind(GL_PIXEL_PACK_BUFFER);
+    const unsigned char *data = (const unsigned char*)ready.map(GL_READ_ONLY);
+    if(data) memcpy(&frame->pixels[0], data, frame->pixels.size());
+    ready.unmap();
+    ready.unbind(GL_PIXEL_PACK_BUFFER);
+    if(!data) return;
+
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        queue.push_back(frame);
+    }
+    wake.notify_one();
+}
+
+void ShowRecorder::threadedFunction() {
+    while(true) {
+        FramePtr frame;
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            wake.wait_for(guard, std::chrono::milliseconds(100), [this] { return !queue.empty() || !isThreadRunning(); });
+            //drain the queue before stopping
+            if(queue.empty()) {
+                if(!isThreadRunning()) break;
+                continue;
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+
+        //the encoder runs at a fixed rate, ticks nothing was captured in repeat the frame
+        int copies = 1;
+        if(writtenTick >= 0) copies = ofClamp(frame->tick - writtenTick, 1, fps * maxGapSeconds);
+        if(!failed && writeFrame(*frame, copies)) {
+            written++;
+        } else {
+            //nothing after a failed write can land, capture() stops the recording
+            if(!failed) ofLogError("ShowRecorder") << "couldn't write to " << path << ": " << strerror(errno) << ", recording stops";
+            failed = true;
+            dropped++;
+        }
+        writtenTick = frame->tick;
+
+        std::unique_lock<std::mutex> guard(mutex);
+        spare.push_back(frame);
+    }
+}
+
+bool ShowRecorder::writeFrame(const Frame &frame, int copies) {
+    int w = area.width, h = area.height, stride = w * 3;
+    if(output == RECORD_FFMPEG) {
+        for(int i=0; i<copies; i++) {
+            if(fwrite(&frame.pixels[0], 1, frame.pixels.size(), pipe) != frame.pixels.size()) return false;
+        }
+        return true;
+    }
+
+    //numbered by tick, so gaps show where nothing new was drawn
+    char name[32];
+    sprintf(name, "frame_%07lld.ppm", frame.tick);
+    FILE *file = fopen(ofFilePath::join(path, name).c_str(), "wb");
+    if(!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+    bool ok = true;
+    for(int y=h-1; y>=0 && ok; y--) {
+        ok = fwrite(&frame.pixels[y * stride], 1, stride, file) == stride;
+    }
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,83 @@
+//
+//  showRecorder.h
+//  PS3_Homography
+//
+//  Records what the projectors show, so no screen recorder has to run next
+//  to the app. Each captured frame the output area is read back into one
+//  of two pixel buffers while the other one, read back a frame earlier, is
+//  copied out, so the render loop never waits on the GPU. Frames go through
+//  a bounded queue to a worker thread that pipes them to a local ffmpeg or
+//  writes them as a numbered ppm sequence. When the worker falls behind,
+//  new frames are dropped and counted. A failed write (ffmpeg exited, disk
+//  full) ends the recording at the next capture.
+//
+
+#ifndef PS3_Homography_showRecorder_h
+#define PS3_Homography_showRecorder_h
+
+#include "ofMain.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+
+enum RecorderOutput {
+    RECORD_FFMPEG = 0,      //h264 through a local ffmpeg process
+    RECORD_PPM              //one ppm per frame, numbered by frame tick
+};
+
+class ShowRecorder : public ofThread {
+
+public:
+    ShowRecorder();
+    ~ShowRecorder();
+
+    //area in window coordinates, fps is the rate frames are taken at
+    bool start(const string &path, RecorderOutput output, const ofRectangle &area, float fps);
+    void stop();
+    bool isRecording() const { return recording; }
+
+    //at the end of draw: reads the area back when a frame is due, or stops
+    //the recording once the worker couldn't write
+    void capture();
+
+    const string& getPath() const { return path; }
+    unsigned long long getWrittenCount() const { return written; }
+    unsigned long long getDroppedCount() const { return dropped; }
+    int getQueueDepth();
+
+    int   maxQueued;        //frames waiting for the worker before new ones are dropped
+    string encoderCommand;  //ffmpeg, %w %h %fps and %path are filled in
+
+private:
+    struct Frame {
+        vector<unsigned char>  pixels;     //rgb, bottom row first as gl reads them
+        long long              tick;
+    };
+    typedef shared_ptr<Frame> FramePtr;
+
+    void threadedFunction();
+    void collect(int index);
+    bool writeFrame(const Frame &frame, int copies);
+
+    bool                          recording;
+    string                        path;
+    RecorderOutput                output;
+    ofRectangle                   area;
+    float                         fps;
+    unsigned long long            startMicros;
+    long long                     lastTick, writtenTick;
+
+    ofBufferObject                pbo[2];
+    bool                          pboPending[2];
+    long long                     pboTick[2];
+    int                           pboIndex;
+
+    std::deque<FramePtr>          queue;
+    vector<FramePtr>              spare;
+    std::condition_variable       wake;
+    FILE*                         pipe;
+    std::atomic<unsigned long long> written, dropped;
+    std::atomic<bool>             failed;
+};
+
+#endif
@@ -0,0 +1,357 @@
+//
+//  silhouetteCollider.cpp
+//  PS3_Homography
+//
+
+#include "silhouetteCollider.h"
+
+//points closer than this (in screen pixels) are welded, box2d rejects them otherwise
+static const float weldDistance = 1.0f;
+static const float minPieceArea = 4.0f;
+//sine of the corner angle below which a piece's vertex counts as collinear
+static const float minCornerSine = 0.01f;
+
+static float signedArea(const vector<ofPoint> &pts) {
+    float a = 0;
+    for(int i=0; i<pts.size(); i++) {
+        const ofPoint &p = pts[i];
+        const ofPoint &q = pts[(i+1) % pts.size()];
+        a += p.x*q.y - q.x*p.y;
+    }
+    return a * 0.5f;
+}
+
+static float cross(const ofPoint &o, const ofPoint &a, const ofPoint &b) {
+    return (a.x-o.x)*(b.y-o.y) - (a.y-o.y)*(b.x-o.x);
+}
+
+static vector<ofPoint> weld(const vector<ofPoint> &pts) {
+    vector<ofPoint> out;
+    for(int i=0; i<pts.size(); i++) {
+        if(out.empty() || out.back().distance(pts[i]) > weldDistance) out.push_back(pts[i]);
+    }
+    while(out.size() > 1 && out.back().distance(out.front()) <= weldDistance) out.pop_back();
+    return out;
+}
+
+static b2Vec2 toWorld(const ofPoint &p) {
+    return b2Vec2(p.x/OFX_BOX2D_SCALE, p.y/OFX_BOX2D_SCALE);
+}
+
+//a piece as box2d vertices, without its collinear corners. false for slivers
+//b2PolygonShape::Set would assert on: edges under b2_linearSlop or no area left
+static bool solidPiece(const vector<ofPoint> &piece, vector<b2Vec2> &verts) {
+    verts.clear();
+    int n = piece.size();
+    for(int i=0; i<n; i++) {
+        b2Vec2 prev = toWorld(piece[(i+n-1) % n]), cur = toWorld(piece[i]), next = toWorld(piece[(i+1) % n]);
+        b2Vec2 e1 = cur - prev, e2 = next - cur;
+        float lengths = e1.Length() * e2.Length();
+        if(lengths <= 0 || fabs(b2Cross(e1, e2)) < lengths * minCornerSine) continue;
+        verts.push_back(cur);
+    }
+    if(verts.size() < 3 || verts.size() > b2_maxPolygonVertices) return false;
+    float area = 0;
+    for(int i=0; i<verts.size(); i++) {
+        const b2Vec2 &a = verts[i], &b = verts[(i+1) % verts.size()];
+        if(b2Distance(a, b) < b2_linearSlop) return false;
+        area += b2Cross(a, b);
+    }
+    return fabs(area) * 0.5f > b2_linearSlop * b2_linearSlop;
+}
+
+SilhouetteColliders::SilhouetteColliders() {
+    world = NULL;
+    mode = COLLIDER_HULL;
+    fidelity = 48;
+    maxPieces = 12;
+    maxProxies = 256;
+    reuseTolerance = 0.08;
+    friction = 0.3;
+    restitution = 0.3;
+    perSilhouetteBudget = maxProxies;
+    rebuilds = 0;
+}
+
+SilhouetteColliders::~SilhouetteColliders() {
+    clear();
+}
+
+void SilhouetteColliders::setup(b2World* _world) {
+    clear();
+    world = _world;
+}
+
+void SilhouetteColliders::setMode(ColliderMode _mode) {
+    if(mode != _mode) clear();
+    mode = _mode;
+}
+
+void SilhouetteColliders::clear() {
+    if(world != NULL) {
+        for(map<int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            world->DestroyBody(it->second.body);
+        }
+    }
+    entries.clear();
+}
+
+int SilhouetteColliders::getProxyCount() const {
+    int total = 0;
+    for(map<int, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        total += it->second.proxies;
+    }
+    return total;
+}
+
+void SilhouetteColliders::begin(int numContours) {
+    rebuilds = 0;
+    perSilhouetteBudget = MAX(3, maxProxies / MAX(1, numContours));
+    for(map<int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        it->second.seen = false;
+    }
+}
+
+void SilhouetteColliders::end() {
+    map<int, Entry>::iterator it = entries.begin();
+    while(it != entries.end()) {
+        if(!it->second.seen) {
+            if(world != NULL) world->DestroyBody(it->second.body);
+            entries.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SilhouetteColliders::changedTooMuch(const Entry &entry, float area, const ofRectangle &bounds) const {
+    if(entry.proxies == 0 || entry.area <= 0) return true;
+    if(fabs(area - entry.area) > entry.area * reuseTolerance) return true;
+    if(fabs(bounds.width - entry.width) > entry.width * reuseTolerance) return true;
+    if(fabs(bounds.height - entry.height) > entry.height * reuseTolerance) return true;
+    return false;
+}
+
+void SilhouetteColliders::update(int label, const vector<ofPoint> &outline, float seconds) {
+    if(world == NULL || mode == COLLIDER_HULL || outline.size() < 3) return;
+    
+    ofPolyline poly(outline);
+    poly.setClosed(true);
+    ofRectangle bounds = poly.getBoundingBox();
+    ofPoint centroid = poly.getCentroid2D();
+    float area = fabs(signedArea(outline));
+    
+    bool isNew = entries.find(label) == entries.end();
+    Entry &entry = entries[label];
+    if(isNew) {
+        b2BodyDef def;
+        def.type = b2_kinematicBody;
+        def.position = toWorld(centroid);
+        entry.body = world->CreateBody(&def);
+        entry.proxies = 0;
+        entry.area = 0;
+        entry.width = entry.height = 0;
+        entry.centroid = centroid;
+    }
+    entry.seen = true;
+    
+    //kinematic bodies push the particles along with the shadow, at the speed it
+    //moved in simulated time so the steps until the next outlines carry it there
+    b2Vec2 velocity(0, 0);
+    if(!isNew && seconds > 0) velocity = toWorld((centroid - entry.centroid) / seconds);
+    entry.body->SetTransform(toWorld(centroid), 0);
+    entry.body->SetLinearVelocity(velocity);
+    entry.centroid = centroid;
+    
+    //a smaller share of the proxy budget than it was built with also means a rebuild
+    if(!changedTooMuch(entry, area, bounds) && entry.proxies <= perSilhouetteBudget) return;
+    
+    int vertexBudget = MIN(fidelity, mode == COLLIDER_CHAIN ? perSilhouetteBudget : fidelity);
+    vector<ofPoint> pts = outline;
+    if(pts.size() > vertexBudget) {
+        pts = poly.getResampledByCount(vertexBudget).getVertices();
+    }
+    pts = weld(pts);
+    for(int i=0; i<pts.size(); i++) pts[i] -= centroid;
+    
+    rebuild(entry, pts, perSilhouetteBudget);
+    entry.area = area;
+    entry.width = bounds.width;
+    entry.height = bounds.height;
+}
+
+void SilhouetteColliders::destroyFixtures(b2Body* body) {
+    b2Fixture* f = body->GetFixtureList();
+    while(f) {
+        b2Fixture* next = f->GetNext();
+        body->DestroyFixture(f);
+        f = next;
+    }
+}
+
+void SilhouetteColliders::rebuild(Entry &entry, const vector<ofPoint> &local, int budget) {
+    destroyFixtures(entry.body);
+    entry.proxies = 0;
+    rebuilds++;
+    if(local.size() < 3) return;
+    
+    b2FixtureDef fd;
+    fd.density = 1.0;
+    fd.friction = friction;
+    fd.restitution = restitution;
+    
+    if(mode == COLLIDER_CHAIN) {
+        vector<b2Vec2> verts(local.size());
+        for(int i=0; i<local.size(); i++) verts[i] = toWorld(local[i]);
+        b2ChainShape chain;
+        chain.CreateLoop(&verts[0], verts.size());
+        fd.shape = &chain;
+        entry.body->CreateFixture(&fd);
+        entry.proxies = chain.GetChildCount();
+    }
+    else if(mode == COLLIDER_DECOMPOSED) {
+        vector<vector<ofPoint> > pieces = decompose(local);
+        
+        //keep the biggest pieces when over budget, small slivers matter least
+        int limit = MIN(maxPieces, budget);
+        if(pieces.size() > limit) {
+            vector<pair<float, int> > order;
+            for(int i=0; i<pieces.size(); i++) order.push_back(make_pair(-fabs(signedArea(pieces[i])), i));
+            sort(order.begin(), order.end());
+            vector<vector<ofPoint> > kept;
+            for(int i=0; i<limit; i++) kept.push_back(pieces[order[i].second]);
+            pieces.swap(kept);
+        }
+        
+        vector<b2Vec2> verts;
+        for(int i=0; i<pieces.size(); i++) {
+            if(fabs(signedArea(pieces[i])) < minPieceArea) continue;
+            if(!solidPiece(pieces[i], verts)) continue;
+            b2PolygonShape shape;
+            shape.Set(&verts[0], verts.size());
+            fd.shape = &shape;
+            entry.body->CreateFixture(&fd);
+            entry.proxies++;
+        }
+    }
+}
+
+vector<vector<ofPoint> > SilhouetteColliders::decompose(const vector<ofPoint> &outline) {
+    vector<vector<ofPoint> > result;
+    vector<ofPoint> pts = weld(outline);
+    int n = pts.size();
+    if(n < 3) return result;
+    if(signedArea(pts) < 0) reverse(pts.begin(), pts.end());
+    
+    //---ear clipping into triangles (indices into pts)
+    vector<vector<int> > polys;
+    vector<int> remaining(n);
+    for(int i=0; i<n; i++) remaining[i] = i;
+    int guard = 0;
+    while(remaining.size() > 3 && guard < n*n) {
+        guard++;
+        bool clipped = false;
+        int m = remaining.size();
+        for(int i=0; i<m; i++) {
+            int a = remaining[(i+m-1) % m], b = remaining[i], c = remaining[(i+1) % m];
+            if(cross(pts[a], pts[b], pts[c]) <= 0) continue;   //reflex
+            bool empty = true;
+            for(int j=0; j<m && empty; j++) {
+                int p = remaining[j];
+                if(p == a || p == b || p == c) continue;
+                if(cross(pts[a], pts[b], pts[p]) >= 0 &&
+                   cross(pts[b], pts[c], pts[p]) >= 0 &&
+                   cross(pts[c], pts[a], pts[p]) >= 0) empty = false;
+            }
+            if(!empty) continue;
+            vector<int> tri(3);
+            tri[0] = a; tri[1] = b; tri[2] = c;
+            polys.push_back(tri);
+            remaining.erase(remaining.begin() + i);
+            clipped = true;
+            break;
+        }
+        //self touching outlines can leave no ear, keep what we have
+        if(!clipped) break;
+    }
+    if(remaining.size() == 3) polys.push_back(remaining);
+    
+    //---hertel-mehlhorn: drop diagonals while the merged piece stays convex
+    vector<bool> alive(polys.size(), true);
+    bool merged = true;
+    while(merged) {
+        merged = false;
+        map<pair<int,int>, int> edgeOwner;
+        for(int p=0; p<polys.size() && !merged; p++) {
+            if(!alive[p]) continue;
+            const vector<int> &P = polys[p];
+            for(int e=0; e<P.size() && !merged; e++) {
+                int u = P[e], v = P[(e+1) % P.size()];
+                map<pair<int,int>, int>::iterator it = edgeOwner.find(make_pair(v, u));
+                if(it == edgeOwner.end()) {
+                    edgeOwner[make_pair(u, v)] = p;
+                    continue;
+                }
+                //shared diagonal u->v in P and v->u in Q
+                int q = it->second;
+                const vector<int> &Q = polys[q];
+                if(P.size() + Q.size() - 2 > b2_maxPolygonVertices) continue;
+                
+                vector<int> joined;
+                int start = (e+1) % P.size();
+                for(int k=0; k<P.size(); k++) joined.push_back(P[(start+k) % P.size()]);   //v ... u
+                int qu = find(Q.begin(), Q.end(), u) - Q.begin();
+                for(int k=1; k<Q.size()-1; k++) joined.push_back(Q[(qu+k) % Q.size()]);   //after u ... before v
+                
+                bool convex = true;
+                int js = joined.size();
+                for(int k=0; k<js && convex; k++) {
+                    if(cross(pts[joined[(k+js-1) % js]], pts[joined[k]], pts[joined[(k+1) % js]]) < 0) convex = false;
+                }
+                if(!convex) continue;
+                polys[q] = joined;
+                alive[p] = false;
+                merged = true;
+            }
+        }
+    }
+    
+    for(int p=0; p<polys.size(); p++) {
+        if(!alive[p]) continue;
+        vector<ofPoint> piece;
+        for(int k=0; k<polys[p].size(); k++) piece.push_back(pts[polys[p][k]]);
+        result.push_back(piece);
+    }
+    return result;
+}
+
+int SilhouetteColliders::draw(const ofRectangle &clip) {
+    int drawn = 0;
+    for(map<int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        const Entry &entry = it->second;
+        //the cached size around the centroid is a loose but cheap bound
+        ofRectangle bounds(entry.centroid.x - entry.width, entry.centroid.y - entry.height, entry.width*2, entry.height*2);
+        if(clip.width > 0 && !clip.intersects(bounds)) continue;
+        drawn++;
+        b2Body* body = entry.body;
+        ofPoint origin = ofPoint(body->GetPosition().x, body->GetPosition().y) * OFX_BOX2D_SCALE;
+        for(b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext()) {
+            ofPolyline outline;
+            if(f->GetType() == b2Shape::e_chain) {
+                b2ChainShape* chain = (b2ChainShape*)f->GetShape();
+                for(int i=0; i<chain->m_count; i++) {
+                    outline.addVertex(origin + ofPoint(chain->m_vertices[i].x, chain->m_vertices[i].y) * OFX_BOX2D_SCALE);
+                }
+            }
+            else if(f->GetType() == b2Shape::e_polygon) {
+                b2PolygonShape* shape = (b2PolygonShape*)f->GetShape();
+                for(int i=0; i<shape->m_count; i++) {
+                    outline.addVertex(origin + ofPoint(shape->m_vertices[i].x, shape->m_vertices[i].y) * OFX_BOX2D_SCALE);
+                }
+            }
+            outline.close();
+            outline.draw();
+        }
+    }
+    return drawn;
+}
@@ -0,0 +1,78 @@
+//
+//  silhouetteCollider.h
+//  PS3_Homography
+//
+//  Box2D bodies for tracked silhouettes that keep their concave outline.
+//  CHAIN builds a chain loop around the outline, DECOMPOSED splits it into
+//  convex pieces. Both are cached per tracker label and only moved while
+//  the shape changes little, and both respect a broad-phase proxy budget.
+//
+
+#ifndef PS3_Homography_silhouetteCollider_h
+#define PS3_Homography_silhouetteCollider_h
+
+#include "ofMain.h"
+#include "ofxBox2d.h"
+
+enum ColliderMode {
+    COLLIDER_HULL = 0,      //single convex ofxBox2dPolygon (the original behaviour)
+    COLLIDER_CHAIN,         //chain loop, one proxy per edge
+    COLLIDER_DECOMPOSED     //convex decomposition, one proxy per piece
+};
+
+class SilhouetteColliders {
+    
+public:
+    SilhouetteColliders();
+    ~SilhouetteColliders();
+    
+    void setup(b2World* world);
+    void setMode(ColliderMode mode);
+    ColliderMode getMode() const { return mode; }
+    
+    //call begin with the number of contours, update once per contour and then end,
+    //which destroys the bodies of labels that were not seen this frame.
+    //seconds is the time box2d simulated since the previous outlines, 0 for none.
+    void begin(int numContours);
+    void update(int label, const vector<ofPoint> &outline, float seconds);
+    void end();
+    void clear();
+    //draws the silhouettes overlapping clip (all of them for an empty clip), returns how many
+    int draw(const ofRectangle &clip = ofRectangle());
+    
+    int getBodyCount() const { return entries.size(); }
+    int getProxyCount() const;
+    int getRebuildCount() const { return rebuilds; }
+    
+    int   fidelity;         //max outline vertices used for a silhouette
+    int   maxPieces;        //max convex pieces per silhouette in DECOMPOSED
+    int   maxProxies;       //broad-phase proxies shared by all silhouettes
+    float reuseTolerance;   //relative change in area/size below which a cached shape is just moved
+    float friction, restitution;
+    
+    //ear clipping followed by Hertel-Mehlhorn merging into convex pieces
+    //of at most b2_maxPolygonVertices. the outline must be a simple polygon.
+    static vector<vector<ofPoint> > decompose(const vector<ofPoint> &outline);
+    
+private:
+    struct Entry {
+        b2Body*  body;
+        ofPoint  centroid;
+        float    area;
+        float    width, height;
+        int      proxies;
+        bool     seen;
+    };
+    
+    bool changedTooMuch(const Entry &entry, float area, const ofRectangle &bounds) const;
+    void rebuild(Entry &entry, const vector<ofPoint> &local, int budget);
+    void destroyFixtures(b2Body* body);
+    
+    b2World*          world;
+    ColliderMode      mode;
+    map<int, Entry>   entries;
+    int               perSilhouetteBudget;
+    int               rebuilds;
+};
+
+#endif
@@ -0,0 +1,87 @@
+//
+//  streamedTexture.cpp
+//  PS3_Homography
+//
+
+#include "streamedTexture.h"
+
+StreamedTexture::StreamedTexture() {
+    pboIndex = 0;
+    pboBytes = 0;
+    source = NULL;
+    stale = false;
+    uploadCount = 0;
+    skippedCount = 0;
+}
+
+void StreamedTexture::markStale(const ofPixels &pixels, shared_ptr<const void> owner) {
+    //a frame that was never drawn is simply replaced by the newer one
+    if(stale) skippedCount++;
+    source = &pixels;
+    sourceOwner = owner;
+    stale = true;
+}
+
+ofTexture& StreamedTexture::getTexture() {
+    if(stale) upload();
+    return texture;
+}
+
+void StreamedTexture::draw(float x, float y) {
+    if(stale) upload();
+    if(texture.isAllocated()) texture.draw(x, y);
+}
+
+void StreamedTexture::draw(float x, float y, float w, float h) {
+    if(stale) upload();
+    if(texture.isAllocated()) texture.draw(x, y, w, h);
+}
+
+void StreamedTexture::clear() {
+    texture.clear();
+    pbo[0] = ofBufferObject();
+    pbo[1] = ofBufferObject();
+    pboBytes = 0;
+    source = NULL;
+    sourceOwner.reset();
+    stale = false;
+}
+
+void StreamedTexture::allocateFor(const ofPixels &pixels) {
+    texture.allocate(pixels);
+    pboBytes = pixels.getTotalBytes();
+    for(int i=0; i<2; i++) {
+        pbo[i].allocate(pboBytes, GL_STREAM_DRAW);
+    }
+    pboIndex = 0;
+}
+
+void StreamedTexture::upload() {
+    stale = false;
+    if(source == NULL || !source->isAllocated()) return;
+    
+    const ofPixels &pixels = *source;
+    if(!texture.isAllocated()
+       || texture.getWidth() != pixels.getWidth()
+       || texture.getHeight() != pixels.getHeight()
+       || pboBytes != pixels.getTotalBytes()) {
+        allocateFor(pixels);
+    }
+    
+    //reallocating orphans the buffer's old storage, so mapping it never waits for
+    //the DMA that may still be reading it. the copy into the texture then runs
+    //from the buffer asynchronously, while the next frame fills the other one.
+    ofBufferObject &buffer = pbo[pboIndex];
+    buffer.allocate(pboBytes, GL_STREAM_DRAW);
+    void *data = buffer.map(GL_WRITE_ONLY);
+    if(data) {
+        memcpy(data, pixels.getData(), pboBytes);
+        buffer.unmap();
+        texture.loadData(buffer, ofGetGLFormat(pixels), ofGetGLType(pixels));
+    }
+    pboIndex = 1 - pboIndex;
+    uploadCount++;
+    //the pixels are in the buffer, the frame they came from may go
+    source = NULL;
+    sourceOwner.reset();
+}
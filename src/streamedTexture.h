@@ -0,0 +1,52 @@
+//
+//  streamedTexture.h
+//  PS3_Homography
+//
+//  A texture that is only uploaded when something actually draws it.
+//  The CPU side marks it stale with the pixels it should show, and the
+//  upload goes through two pixel buffer objects used in turn, each one
+//  orphaned before it is filled, so the copy into it never waits on the
+//  DMA still reading the previous frame.
+//
+
+#ifndef PS3_Homography_streamedTexture_h
+#define PS3_Homography_streamedTexture_h
+
+#include "ofMain.h"
+
+class StreamedTexture {
+    
+public:
+    StreamedTexture();
+    
+    //pixels are referenced, not copied. they must stay valid until the next
+    //draw or clear: owner, when given, is held until then to guarantee it.
+    void markStale(const ofPixels &pixels, shared_ptr<const void> owner = shared_ptr<const void>());
+    bool isStale() const { return stale; }
+    bool isAllocated() const { return texture.isAllocated(); }
+    
+    //uploads first if the pixels changed since the last draw.
+    ofTexture& getTexture();
+    void draw(float x, float y);
+    void draw(float x, float y, float w, float h);
+    
+    //release the GL objects, the next upload reallocates at the new size.
+    void clear();
+    
+    int uploadCount;
+    int skippedCount;
+    
+private:
+    void upload();
+    void allocateFor(const ofPixels &pixels);
+    
+    ofTexture        texture;
+    ofBufferObject   pbo[2];
+    int              pboIndex;
+    size_t           pboBytes;
+    const ofPixels*  source;
+    shared_ptr<const void> sourceOwner;
+    bool             stale;
+};
+
+#endif
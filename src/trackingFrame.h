@@ -0,0 +1,37 @@
+//
+//  trackingFrame.h
+//  PS3_Homography
+//
+//  Plain copy of what the tracker found in one camera frame, so the
+//  physics, overlay and output stages don't have to reach into
+//  the ContourFinder.
+//
+
+#ifndef PS3_Homography_trackingFrame_h
+#define PS3_Homography_trackingFrame_h
+
+#include "ofMain.h"
+
+struct TrackedBlob {
+    int          label;
+    int          age;
+    ofPolyline   contour;       //raw outline in warped camera space
+    ofPolyline   simplified;    //outline after the vertex budget, used for drawing and physics
+    ofVec2f      centroid;
+    ofVec2f      center;
+    ofVec2f      velocity;
+    ofRectangle  bounds;
+    float        area;
+    float        perimeter;     //outline length in pixels, kept when the outline itself is not traced
+    string       puppet;        //name of the recognised puppet, empty for none
+    float        puppetDistance;//descriptor distance to its closest template
+};
+
+struct TrackingFrame {
+    TrackingFrame() : sequence(0), captureMicros(0) {}
+    unsigned long long   sequence;
+    unsigned long long   captureMicros;
+    vector<TrackedBlob>  blobs;
+};
+
+#endif
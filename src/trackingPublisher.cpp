@@ -0,0 +1,400 @@
+//
+//  trackingPublisher.cpp
+//  PS3_Homography
+//
+
+#include "trackingPublisher.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const size_t packetHeaderBytes = 32;
+static const size_t packetBlobBytes = 48;
+
+template<typename T> static void put(vector<unsigned char> &out, const T &value) {
+    const unsigned char *bytes = (const unsigned char*)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T> static bool take(const unsigned char *&data, const unsigned char *end, T &value) {
+    if(data + sizeof(T) > end) return false;
+    memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+}
+
+static const ofPolyline& outlineOf(const TrackedBlob &blob) {
+    return blob.simplified.size() > 0 ? blob.simplified : blob.contour;
+}
+
+//the count largest blobs, in frame order
+static void pickBlobs(const TrackingFrame &frame, size_t count, vector<int> &picked) {
+    picked.resize(frame.blobs.size());
+    for(int i=0; i<picked.size(); i++) picked[i] = i;
+    if(count >= picked.size()) return;
+    std::nth_element(picked.begin(), picked.begin() + count, picked.end(), [&](int a, int b) {
+        return frame.blobs[a].area > frame.blobs[b].area;
+    });
+    picked.resize(count);
+    std::sort(picked.begin(), picked.end());
+}
+
+void TrackingPacket::encode(const TrackingFrame &frame, int camWidth, int camHeight, size_t maxBytes, vector<unsigned char> &out, size_t blobOverhead) {
+    uint16_t flags = 0;
+    size_t blobBytes = packetBlobBytes + blobOverhead;
+    size_t maxBlobs = maxBytes > packetHeaderBytes ? (maxBytes - packetHeaderBytes) / blobBytes : 0;
+    maxBlobs = MIN(maxBlobs, (size_t)UINT16_MAX);
+    vector<int> picked;
+    pickBlobs(frame, maxBlobs, picked);
+    if(picked.size() < frame.blobs.size()) flags |= TRACKING_PACKET_DROPPED;
+    
+    size_t fixed = packetHeaderBytes + blobBytes * picked.size();
+    size_t vertices = 0;
+    for(int i=0; i<picked.size(); i++) vertices += outlineOf(frame.blobs[picked[i]]).size();
+    
+    //when the frame doesn't fit every outline gets the same share of the vertices
+    //that do, rounded down. too few to give each blob one and no outlines go out
+    size_t budget = vertices;
+    if(fixed + vertices * 8 > maxBytes) {
+        flags |= TRACKING_PACKET_TRUNCATED;
+        budget = maxBytes > fixed ? (maxBytes - fixed) / 8 : 0;
+        if(budget < picked.size()) budget = 0;
+    }
+    
+    out.clear();
+    put(out, magic);
+    put(out, version);
+    put(out, flags);
+    put(out, (uint64_t)frame.sequence);
+    put(out, (uint64_t)frame.captureMicros);
+    put(out, (uint16_t)camWidth);
+    put(out, (uint16_t)camHeight);
+    put(out, (uint16_t)picked.size());
+    put(out, (uint16_t)0);
+    for(int i=0; i<picked.size(); i++) {
+        const TrackedBlob &blob = frame.blobs[picked[i]];
+        const ofPolyline &outline = outlineOf(blob);
+        put(out, (int32_t)blob.label);
+        put(out, (int32_t)blob.age);
+        put(out, blob.centroid.x);
+        put(out, blob.centroid.y);
+        put(out, blob.velocity.x);
+        put(out, blob.velocity.y);
+        put(out, blob.area);
+        put(out, blob.bounds.x);
+        put(out, blob.bounds.y);
+        put(out, blob.bounds.width);
+        put(out, blob.bounds.height);
+        size_t size = outline.size();
+        size_t kept = budget < vertices ? (size_t)((uint64_t)size * budget / vertices) : size;
+        uint16_t count = MIN(kept, (size_t)UINT16_MAX);
+        put(out, count);
+        put(out, (uint16_t)0);
+        for(int k=0; k<count; k++) {
+            const ofPoint &p = outline[(size_t)k * size / count];
+            put(out, p.x);
+            put(out, p.y);
+        }
+    }
+    //only a maxBytes below the header itself can get here
+    if(out.size() > maxBytes) {
+        ofLogError("TrackingPacket") << "packet of " << out.size() << " bytes is over the " << maxBytes << " byte limit";
+    }
+}
+
+bool TrackingPacket::decode(const unsigned char *data, size_t bytes, TrackingFrame &frame, int &camWidth, int &camHeight) {
+    const unsigned char *end = data + bytes;
+    uint32_t m;
+    uint16_t v, flags, w, h, blobCount, reserved;
+    uint64_t sequence, micros;
+    if(!take(data, end, m) || m != magic) return false;
+    if(!take(data, end, v) || v != version) return false;
+    take(data, end, flags);
+    take(data, end, sequence);
+    take(data, end, micros);
+    take(data, end, w);
+    take(data, end, h);
+    take(data, end, blobCount);
+    if(!take(data, end, reserved)) return false;
+    
+    frame.sequence = sequence;
+    frame.captureMicros = micros;
+    camWidth = w;
+    camHeight = h;
+    frame.blobs.resize(blobCount);
+    for(int i=0; i<blobCount; i++) {
+        TrackedBlob &blob = frame.blobs[i];
+        int32_t label, age;
+        uint16_t count;
+        take(data, end, label);
+        take(data, end, age);
+        take(data, end, blob.centroid.x);
+        take(data, end, blob.centroid.y);
+        take(data, end, blob.velocity.x);
+        take(data, end, blob.velocity.y);
+        take(data, end, blob.area);
+        take(data, end, blob.bounds.x);
+        take(data, end, blob.bounds.y);
+        take(data, end, blob.bounds.width);
+        take(data, end, blob.bounds.height);
+        take(data, end, count);
+        if(!take(data, end, reserved)) return false;
+        blob.label = label;
+        blob.age = age;
+        blob.center = blob.bounds.getCenter();
+        blob.simplified.clear();
+        for(int k=0; k<count; k++) {
+            float x, y;
+            take(data, end, x);
+            if(!take(data, end, y)) return false;
+            blob.simplified.addVertex(x, y);
+        }
+        blob.simplified.setClosed(true);
+        blob.contour = blob.simplified;
+        blob.perimeter = blob.contour.getPerimeter();
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------- osc
+static void oscString(vector<unsigned char> &out, const string &s) {
+    out.insert(out.end(), s.begin(), s.end());
+    out.push_back(0);
+    while(out.size() % 4) out.push_back(0);
+}
+
+static void oscInt32(vector<unsigned char> &out, int32_t value) {
+    uint32_t be = htonl((uint32_t)value);
+    put(out, be);
+}
+
+static void oscInt64(vector<unsigned char> &out, uint64_t value) {
+    oscInt32(out, (int32_t)(value >> 32));
+    oscInt32(out, (int32_t)(value & 0xffffffff));
+}
+
+static void oscFloat(vector<unsigned char> &out, float value) {
+    int32_t bits;
+    memcpy(&bits, &value, 4);
+    oscInt32(out, bits);
+}
+
+//bundle elements are prefixed with their size
+static size_t beginElement(vector<unsigned char> &out) {
+    oscInt32(out, 0);
+    return out.size();
+}
+
+static void endElement(vector<unsigned char> &out, size_t start) {
+    uint32_t be = htonl((uint32_t)(out.size() - start));
+    memcpy(&out[start - 4], &be, 4);
+}
+
+void TrackingPacket::encodeOsc(const TrackingFrame &frame, const vector<unsigned char> &packet, vector<unsigned char> &out) {
+    //the same blobs encode kept, its count is in the header
+    uint16_t blobCount = 0;
+    if(packet.size() >= packetHeaderBytes) memcpy(&blobCount, &packet[packetHeaderBytes - 4], 2);
+    vector<int> picked;
+    pickBlobs(frame, blobCount, picked);
+    
+    out.clear();
+    oscString(out, "#bundle");
+    oscInt64(out, 1);   //immediately
+    
+    size_t start = beginElement(out);
+    oscString(out, "/shadow/frame");
+    oscString(out, ",hhi");
+    oscInt64(out, frame.sequence);
+    oscInt64(out, frame.captureMicros);
+    oscInt32(out, picked.size());
+    endElement(out, start);
+    
+    for(int i=0; i<picked.size(); i++) {
+        const TrackedBlob &blob = frame.blobs[picked[i]];
+        start = beginElement(out);
+        oscString(out, "/shadow/blob");
+        oscString(out, ",iifffff");
+        oscInt32(out, blob.label);
+        oscInt32(out, blob.age);
+        oscFloat(out, blob.centroid.x);
+        oscFloat(out, blob.centroid.y);
+        oscFloat(out, blob.velocity.x);
+        oscFloat(out, blob.velocity.y);
+        oscFloat(out, blob.area);
+        endElement(out, start);
+    }
+    
+    start = beginElement(out);
+    oscString(out, "/shadow/packet");
+    oscString(out, ",b");
+    oscInt32(out, packet.size());
+    out.insert(out.end(), packet.begin(), packet.end());
+    while(out.size() % 4) out.push_back(0);
+    endElement(out, start);
+}
+
+//finds the /shadow/packet blob inside a bundle made by encodeOsc
+static bool findOscPacket(const unsigned char *data, size_t bytes, const unsigned char *&packet, size_t &packetBytes) {
+    const unsigned char *end = data + bytes;
+    if(bytes < 16 || memcmp(data, "#bundle", 8) != 0) return false;
+    data += 16;
+    while(data + 4 <= end) {
+        uint32_t size;
+        memcpy(&size, data, 4);
+        size = ntohl(size);
+        data += 4;
+        if(data + size > end) return false;
+        static const char address[] = "/shadow/packet\0\0,b\0\0";
+        if(size > sizeof(address) + 4 && memcmp(data, address, sizeof(address) - 1) == 0) {
+            const unsigned char *p = data + sizeof(address) - 1;
+            uint32_t length;
+            memcpy(&length, p, 4);
+            length = ntohl(length);
+            if(p + 4 + length > data + size) return false;
+            packet = p + 4;
+            packetBytes = length;
+            return true;
+        }
+        data += size;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------- publisher
+TrackingPublisher::TrackingPublisher() {
+    udpSocket = -1;
+    udpOsc = false;
+    maxUdpBytes = 1400;
+    sent = failed = 0;
+}
+
+TrackingPublisher::~TrackingPublisher() {
+    closeUdp();
+    closeSharedMemory();
+}
+
+bool TrackingPublisher::setupUdp(const string &host, int port, bool osc) {
+    closeUdp();
+    struct addrinfo hints, *result = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if(getaddrinfo(host.c_str(), ofToString(port).c_str(), &hints, &result) != 0 || result == NULL) {
+        ofLogError("TrackingPublisher") << "couldn't resolve " << host;
+        return false;
+    }
+    addr.assign((unsigned char*)result->ai_addr, (unsigned char*)result->ai_addr + result->ai_addrlen);
+    freeaddrinfo(result);
+    
+    udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if(udpSocket < 0) return false;
+    //a full socket buffer drops the frame instead of stalling tracking
+    fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL) | O_NONBLOCK);
+    udpOsc = osc;
+    ofLogNotice("TrackingPublisher") << "sending " << (osc ? "osc" : "packets") << " to " << host << ":" << port;
+    return true;
+}
+
+bool TrackingPublisher::setupSharedMemory(const string &name, int slots, int slotBytes) {
+    if(!ring.create(name, slots, slotBytes)) return false;
+    ofLogNotice("TrackingPublisher") << "publishing to shared memory /" << name;
+    return true;
+}
+
+void TrackingPublisher::closeUdp() {
+    if(udpSocket >= 0) ::close(udpSocket);
+    udpSocket = -1;
+}
+
+void TrackingPublisher::closeSharedMemory() {
+    ring.close();
+}
+
+void TrackingPublisher::publish(const TrackingFrame &frame, int camWidth, int camHeight) {
+    if(udpSocket < 0 && !ring.isOpen()) return;
+    
+    if(ring.isOpen()) {
+        TrackingPacket::encode(frame, camWidth, camHeight, ring.getSlotBytes(), packet);
+        if(ring.write(&packet[0], packet.size(), frame.captureMicros)) sent++;
+        else failed++;
+    }
+    if(udpSocket >= 0) {
+        const vector<unsigned char> *datagram = &packet;
+        if(!udpOsc) {
+            TrackingPacket::encode(frame, camWidth, camHeight, maxUdpBytes, packet);
+        } else {
+            size_t room = maxUdpBytes > TrackingPacket::oscFixedBytes ? maxUdpBytes - TrackingPacket::oscFixedBytes : 0;
+            TrackingPacket::encode(frame, camWidth, camHeight, room, packet, TrackingPacket::oscBlobBytes);
+            TrackingPacket::encodeOsc(frame, packet, oscPacket);
+            datagram = &oscPacket;
+        }
+        if(datagram->size() > maxUdpBytes) {
+            failed++;
+            return;
+        }
+        ssize_t result = sendto(udpSocket, &(*datagram)[0], datagram->size(), 0, (const struct sockaddr*)&addr[0], addr.size());
+        if(result == (ssize_t)datagram->size()) sent++;
+        else failed++;
+    }
+}
+
+//---------------------------------------------------------------------- receiver
+TrackingReceiver::TrackingReceiver() {
+    udpSocket = -1;
+    udpOsc = false;
+    camWidth = camHeight = 0;
+}
+
+TrackingReceiver::~TrackingReceiver() {
+    close();
+}
+
+bool TrackingReceiver::listenUdp(int port, bool osc) {
+    udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if(udpSocket < 0) return false;
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if(bind(udpSocket, (struct sockaddr*)&local, sizeof(local)) != 0) {
+        ofLogError("TrackingReceiver") << "couldn't bind udp port " << port;
+        close();
+        return false;
+    }
+    fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL) | O_NONBLOCK);
+    udpOsc = osc;
+    buffer.resize(65536);
+    return true;
+}
+
+bool TrackingReceiver::openSharedMemory(const string &name) {
+    return ring.open(name);
+}
+
+void TrackingReceiver::close() {
+    if(udpSocket >= 0) ::close(udpSocket);
+    udpSocket = -1;
+    ring.close();
+}
+
+bool TrackingReceiver::receiveUdp(TrackingFrame &frame) {
+    if(udpSocket < 0) return false;
+    buffer.resize(65536);
+    ssize_t bytes = recv(udpSocket, &buffer[0], buffer.size(), 0);
+    if(bytes <= 0) return false;
+    const unsigned char *data = &buffer[0];
+    size_t length = bytes;
+    if(udpOsc && !findOscPacket(&buffer[0], bytes, data, length)) return false;
+    return TrackingPacket::decode(data, length, frame, camWidth, camHeight);
+}
+
+bool TrackingReceiver::receiveSharedMemory(TrackingFrame &frame) {
+    uint64_t timestamp;
+    uint32_t tag;
+    if(!ring.readNext(buffer, timestamp, tag)) return false;
+    return TrackingPacket::decode(&buffer[0], buffer.size(), frame, camWidth, camHeight);
+}
@@ -0,0 +1,100 @@
+//
+//  trackingPublisher.h
+//  PS3_Homography
+//
+//  Sends each TrackingFrame out of the app as a small versioned binary
+//  packet: over UDP to other machines (raw, or wrapped as an OSC bundle
+//  for tools that speak OSC) and through a SharedRing for processes on the
+//  same host. TrackingReceiver is the other end, used by consumers and by
+//  the loopback check.
+//
+//  packet (little endian):
+//    header  uint32 magic "SPTK", uint16 version, uint16 flags,
+//            uint64 sequence, uint64 captureMicros (system clock),
+//            uint16 camWidth, uint16 camHeight, uint16 blobCount, uint16 reserved
+//    blob    int32 label, int32 age, float centroid[2], velocity[2], area,
+//            bounds[4], uint16 vertexCount, uint16 reserved, float xy[vertexCount*2]
+//
+
+#ifndef PS3_Homography_trackingPublisher_h
+#define PS3_Homography_trackingPublisher_h
+
+#include "ofMain.h"
+#include "trackingFrame.h"
+#include "sharedRing.h"
+#include <stdint.h>
+
+enum TrackingPacketFlags {
+    TRACKING_PACKET_TRUNCATED = 1,     //outlines were thinned to fit the packet size
+    TRACKING_PACKET_DROPPED = 2        //the smallest blobs were left out to fit the packet size
+};
+
+namespace TrackingPacket {
+    static const uint32_t magic = 0x4b545053;   //"SPTK"
+    static const uint16_t version = 1;
+    
+    //outlines are thinned until the packet fits in maxBytes, when even the blobs without
+    //outlines don't fit only the largest are sent. blobOverhead is what the caller adds
+    //per blob around the packet, counted against maxBytes too
+    void encode(const TrackingFrame &frame, int camWidth, int camHeight, size_t maxBytes, vector<unsigned char> &out, size_t blobOverhead = 0);
+    bool decode(const unsigned char *data, size_t bytes, TrackingFrame &frame, int &camWidth, int &camHeight);
+    
+    //the same packet as an OSC bundle: /shadow/frame with the header fields,
+    ///shadow/blob per blob in the packet (label, age, centroid, velocity, area)
+    //and the whole binary packet as a blob in /shadow/packet
+    static const size_t oscFixedBytes = 95;     //bundle, /shadow/frame and /shadow/packet around the packet
+    static const size_t oscBlobBytes = 60;      //each /shadow/blob
+    void encodeOsc(const TrackingFrame &frame, const vector<unsigned char> &packet, vector<unsigned char> &out);
+}
+
+class TrackingPublisher {
+    
+public:
+    TrackingPublisher();
+    ~TrackingPublisher();
+    
+    bool setupUdp(const string &host, int port, bool osc);
+    bool setupSharedMemory(const string &name, int slots = 64, int slotBytes = 32768);
+    void closeUdp();
+    void closeSharedMemory();
+    
+    void publish(const TrackingFrame &frame, int camWidth, int camHeight);
+    
+    int   maxUdpBytes;       //keep under the path MTU to avoid ip fragmentation
+    
+    uint64_t getSentCount() const { return sent; }
+    uint64_t getFailedCount() const { return failed; }
+    
+private:
+    int                     udpSocket;
+    bool                    udpOsc;
+    vector<unsigned char>   addr;       //sockaddr_in
+    SharedRing              ring;
+    vector<unsigned char>   packet, oscPacket;
+    uint64_t                sent, failed;
+};
+
+class TrackingReceiver {
+    
+public:
+    TrackingReceiver();
+    ~TrackingReceiver();
+    
+    bool listenUdp(int port, bool osc);
+    bool openSharedMemory(const string &name);
+    void close();
+    
+    //non blocking, returns false when nothing new arrived
+    bool receiveUdp(TrackingFrame &frame);
+    bool receiveSharedMemory(TrackingFrame &frame);
+    
+    int camWidth, camHeight;
+    
+private:
+    int                     udpSocket;
+    bool                    udpOsc;
+    SharedRing              ring;
+    vector<unsigned char>   buffer;
+};
+
+#endif